@@ -23,7 +23,10 @@
 #include <map>
 #include <list>
 #include <set>
+#include <iomanip>
+#include <cmath>
 #include "BGHMatcher.h"
+#include "BGHSimd.h"
 #include "opencv2/highgui.hpp"
 
 
@@ -38,83 +41,1599 @@ namespace BGHMatcher
     };
 
 
+    // STL structure for building a lookup table dynamically
+    // maps gradient code to a set of offset points with vote counts
+    typedef std::map<uint8_t, std::map<cv::Point, uint16_t, cmpCvPoint>> T_lookup_map;
+
+
+    // puts dynamic lookup table into a fixed non-STL structure
+    // that is much more efficient when running debug code
+    static void fill_ghough_table(
+        T_lookup_map& rlookup_table,
+        const cv::Size img_sz,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        // add blank entry for any code not in map for codes 0-max
+        int max_code = (rlookup_table.empty()) ? 0 : rlookup_table.rbegin()->first;
+        for (int key = 0; key <= max_code; key++)
+        {
+            if (rlookup_table.count(static_cast<uint8_t>(key)) == 0)
+            {
+                rlookup_table[static_cast<uint8_t>(key)] = {};
+            }
+        }
+
+        // blow away any old data in table
+        rtable.clear();
+
+        rtable.img_sz = img_sz;
+        rtable.elem_ct = rlookup_table.size();
+        rtable.elems = new T_ghough_elem[rtable.elem_ct];
+        for (const auto& r : rlookup_table)
+        {
+            uint8_t key = r.first;
+            size_t n = r.second.size();
+            if (n > 0)
+            {
+                rtable.elems[key].ct = n;
+                rtable.elems[key].cap = n;
+                rtable.elems[key].pt_votes = new T_pt_votes[n];
+                size_t k = 0;
+                for (const auto& rr : r.second)
+                {
+                    cv::Point pt = rr.first;
+                    rtable.elems[key].pt_votes[k++] = { pt, rr.second };
+                    rtable.total_votes += rr.second;
+                    rtable.total_entries++;
+                }
+            }
+        }
+    }
+
+
+    // clamps angle step parameter to its supported range
+    static double get_ang_step(const BGHMatcher::T_ghough_params& rparams)
+    {
+        double ang_step = rparams.ang_step;
+        ang_step = (ang_step > ANG_STEP_MAX) ? ANG_STEP_MAX : ang_step;
+        ang_step = (ang_step < ANG_STEP_MIN) ? ANG_STEP_MIN : ang_step;
+        return ang_step;
+    }
+
+
+    // shifts a gradient code by a number of code steps
+    // results are always 1 to N
+    static uint8_t shift_code(const int code, const int shift, const int n)
+    {
+        const int c0 = (code - 1) % n;
+        return static_cast<uint8_t>((((c0 + shift) % n) + n) % n + 1);
+    }
+
+
+    // adds votes to a dynamic lookup table entry without overflow
+    static void add_votes(uint16_t& rvotes, const int votes)
+    {
+        rvotes = static_cast<uint16_t>(std::min<int>(0xFFFF, rvotes + votes));
+    }
+
+
+    // adds scaled and rotated entries of a table to a dynamic lookup table
+    // only codes in canonical range (shifted code 1 to max_code) are added
+    static void add_posed_entries(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const double scale,
+        const double angle,
+        const int shift,
+        const int max_code,
+        T_lookup_map& rlookup_table)
+    {
+        const int n = get_ghough_code_ct(rsrc.params);
+        const double ca = scale * std::cos(angle);
+        const double sa = scale * std::sin(angle);
+        for (size_t key = 1; key < rsrc.elem_ct; key++)
+        {
+            if (shift_code(static_cast<int>(key), 0, n) > max_code)
+            {
+                continue;
+            }
+
+            const uint8_t new_key = shift_code(static_cast<int>(key), shift, n);
+            const T_ghough_elem& relem = rsrc.elems[key];
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                const T_pt_votes& rpv = relem.pt_votes[k];
+                cv::Point offset_pt = {
+                    cvRound(ca * rpv.pt.x - sa * rpv.pt.y),
+                    cvRound(sa * rpv.pt.x + ca * rpv.pt.y) };
+                add_votes(rlookup_table[new_key][offset_pt], rpv.votes);
+            }
+        }
+    }
+
+
+    // adds all entries of a table to a dynamic lookup table without changing them
+    static void add_entries(
+        const BGHMatcher::T_ghough_table& rsrc,
+        T_lookup_map& rlookup_table)
+    {
+        for (size_t key = 0; key < rsrc.elem_ct; key++)
+        {
+            const T_ghough_elem& relem = rsrc.elems[key];
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                const T_pt_votes& rpv = relem.pt_votes[k];
+                add_votes(rlookup_table[static_cast<uint8_t>(key)][rpv.pt], rpv.votes);
+            }
+        }
+    }
+
+
     void create_ghough_table(
         const cv::Mat& rgrad,
         const double scale,
         BGHMatcher::T_ghough_table& rtable)
     {
-        // sanity check scale value
-        double fac = scale;
-        if (fac < 0.1) fac = 0.1;
-        if (fac > 10.0) fac = 10.0;
+        // sanity check scale value
+        double fac = scale;
+        if (fac < 0.1) fac = 0.1;
+        if (fac > 10.0) fac = 10.0;
+
+        // calculate centering offset
+        int row_offset = rgrad.rows / 2;
+        int col_offset = rgrad.cols / 2;
+
+        // iterate through the gradient image pixel-by-pixel
+        // use STL structures to build a lookup table dynamically
+        T_lookup_map lookup_table;
+        for (int i = 0; i < rgrad.rows; i++)
+        {
+            const uint8_t * pix = rgrad.ptr<uint8_t>(i);
+            for (int j = 0; j < rgrad.cols; j++)
+            {
+                // get the gradient pixel value (key)
+                // everything non-zero is valid
+                const uint8_t uu = pix[j];
+                if (uu)
+                {
+                    // the scaling operation can make one point have multiple votes
+                    // so the vote count is mapped to a point and incremented
+                    cv::Point offset_pt = cv::Point(col_offset - j, row_offset - i);
+                    offset_pt.x = static_cast<int>(fac * offset_pt.x);
+                    offset_pt.y = static_cast<int>(fac * offset_pt.y);
+                    lookup_table[uu][offset_pt]++;
+                }
+            }
+        }
+
+        fill_ghough_table(lookup_table, rgrad.size(), rtable);
+    }
+
+
+    void create_ghough_table_view(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        rtable.clear();
+        rtable.elem_ct = rsrc.elem_ct;
+        rtable.elems = new T_ghough_elem[rtable.elem_ct];
+        rtable.is_view = true;
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            // entries are never written through a view table
+            rtable.elems[key].ct = rsrc.elems[key].ct;
+            rtable.elems[key].tail_ct = rsrc.elems[key].tail_ct;
+            rtable.elems[key].dead_ct = rsrc.elems[key].dead_ct;
+            rtable.elems[key].pt_votes = rsrc.elems[key].pt_votes;
+        }
+
+        rtable.params = rsrc.params;
+        rtable.sym = rsrc.sym;
+        rtable.img_sz = rsrc.img_sz;
+        rtable.bin = rsrc.bin;
+        rtable.is_compressed = rsrc.is_compressed;
+        rtable.total_votes = rsrc.total_votes;
+        rtable.total_entries = rsrc.total_entries;
+    }
+
+
+    void get_scaled_ghough_offsets(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double scale,
+        BGHMatcher::T_ghough_scaled_offsets& roffsets)
+    {
+        // same sanity check as table creation
+        double fac = scale;
+        if (fac < 0.1) fac = 0.1;
+        if (fac > 10.0) fac = 10.0;
+
+        // integer division truncates toward zero like a cast from double
+        const int64_t FX_ONE = 1 << 16;
+        const int64_t fx = static_cast<int64_t>(std::llround(fac * FX_ONE));
+
+        // one extra start index for every possible code
+        // so any pixel value can be looked up
+        roffsets.scale = fac;
+        roffsets.start.assign(257, 0);
+        roffsets.pt_votes.clear();
+        roffsets.pt_votes.reserve(rtable.total_entries);
+        for (size_t key = 0; key < 256; key++)
+        {
+            roffsets.start[key] = roffsets.pt_votes.size();
+            if (key < rtable.elem_ct)
+            {
+                const T_ghough_elem& relem = rtable.elems[key];
+                for (size_t k = 0; k < relem.ct; k++)
+                {
+                    const T_pt_votes& rpv = relem.pt_votes[k];
+                    T_pt_votes scaled;
+                    scaled.pt.x = static_cast<int>((rpv.pt.x * fx) / FX_ONE);
+                    scaled.pt.y = static_cast<int>((rpv.pt.y * fx) / FX_ONE);
+                    scaled.votes = rpv.votes;
+                    roffsets.pt_votes.push_back(scaled);
+                }
+            }
+        }
+        roffsets.start[256] = roffsets.pt_votes.size();
+    }
+
+
+    void create_binned_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const int bin,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        // sanity check bin factor
+        const int b = (bin < 1) ? 1 : bin;
+
+        // quantize every offset in source table
+        // rounding (instead of truncating) keeps the quantization error centered
+        T_lookup_map lookup_table;
+        for (size_t key = 0; key < rsrc.elem_ct; key++)
+        {
+            const T_ghough_elem& relem = rsrc.elems[key];
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                const T_pt_votes& rpv = relem.pt_votes[k];
+                cv::Point offset_pt = {
+                    cvFloor((rpv.pt.x + 0.5 * b) / b),
+                    cvFloor((rpv.pt.y + 0.5 * b) / b) };
+                uint16_t& rvotes = lookup_table[static_cast<uint8_t>(key)][offset_pt];
+                rvotes = static_cast<uint16_t>(std::min<int>(0xFFFF, rvotes + rpv.votes));
+            }
+        }
+
+        // source and destination may be the same table
+        // so save metadata before the destination is cleared
+        const T_ghough_params params = rsrc.params;
+        fill_ghough_table(lookup_table, rsrc.img_sz, rtable);
+        rtable.params = params;
+        rtable.bin = b;
+    }
+
+
+    cv::Rect get_ghough_table_extent(
+        const BGHMatcher::T_ghough_table& rtable)
+    {
+        // start with a single point at origin
+        // so an empty table still has a valid extent
+        cv::Point pt_min = { 0, 0 };
+        cv::Point pt_max = { 0, 0 };
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            const T_ghough_elem& relem = rtable.elems[key];
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                const cv::Point& rpt = relem.pt_votes[k].pt;
+                pt_min.x = std::min(pt_min.x, rpt.x);
+                pt_min.y = std::min(pt_min.y, rpt.y);
+                pt_max.x = std::max(pt_max.x, rpt.x);
+                pt_max.y = std::max(pt_max.y, rpt.y);
+            }
+        }
+        return cv::Rect(pt_min, pt_max + cv::Point(1, 1));
+    }
+
+    
+    void create_ghough_cascade_masks(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const double thr,
+        cv::Mat& rcand_mask,
+        cv::Mat& rvote_mask)
+    {
+        // a pixel at p votes at q=p+d so the pixels that can vote for q
+        // are in the window from q minus the max offset to q minus the min offset
+        const cv::Rect ext = get_ghough_table_extent(rtable);
+        const int dx0 = ext.x + ext.width - 1;
+        const int dx1 = -ext.x;
+        const int dy0 = ext.y + ext.height - 1;
+        const int dy1 = -ext.y;
+
+        cv::Mat code_mask;
+        cv::Mat code_integral;
+        cv::Mat bound = cv::Mat::zeros(rimg.size(), CV_32F);
+        for (size_t key = 1; key < rtable.elem_ct; key++)
+        {
+            const T_ghough_elem& relem = rtable.elems[key];
+            if (relem.ct == 0)
+            {
+                continue;
+            }
+
+            // template histogram for this code is its total votes
+            // each matching pixel in window can add at most the max votes of one entry
+            float code_votes = 0.0f;
+            float code_votes_max = 0.0f;
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                code_votes += relem.pt_votes[k].votes;
+                code_votes_max = std::max<float>(code_votes_max, relem.pt_votes[k].votes);
+            }
+
+            // count of code in any window is 4 lookups in the integral image
+            code_mask = (rimg == static_cast<double>(key)) / 255;
+            cv::integral(code_mask, code_integral, CV_32S);
+            for (int i = 0; i < rimg.rows; i++)
+            {
+                const int y0 = std::max(0, i - dy0);
+                const int y1 = std::min(rimg.rows, i + dy1 + 1);
+                const int * pint0 = code_integral.ptr<int>(y0);
+                const int * pint1 = code_integral.ptr<int>(y1);
+                float * pbound = bound.ptr<float>(i);
+                for (int j = 0; j < rimg.cols; j++)
+                {
+                    const int x0 = std::max(0, j - dx0);
+                    const int x1 = std::min(rimg.cols, j + dx1 + 1);
+                    const int n = pint1[x1] - pint1[x0] - pint0[x1] + pint0[x0];
+                    pbound[j] += std::min(n * code_votes_max, code_votes);
+                }
+            }
+        }
+        rcand_mask = (bound >= (thr * rtable.total_votes));
+
+        // grow candidates by the (negated) range of offsets to get the voting pixels
+        cv::Mat kernel = cv::Mat::ones(ext.size(), CV_8U);
+        cv::dilate(rcand_mask, rvote_mask, kernel, { -ext.x, -ext.y });
+    }
+
+
+    size_t count_ghough_votes(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable)
+    {
+        // histogram of codes then sum of code counts times entries per code
+        size_t code_hist[256] = { 0 };
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = 1; j < (rimg.cols - 1); j++)
+            {
+                code_hist[pix[j]]++;
+            }
+        }
+
+        size_t result = 0;
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            result += code_hist[key] * rtable.elems[key].ct;
+        }
+        return result;
+    }
+
+
+    // votes into sparse accumulator sized for a known number of votes
+    static void vote_sparse(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const size_t n_votes,
+        BGHMatcher::T_ghough_sparse_acc& racc)
+    {
+        const uint32_t EMPTY = 0xFFFFFFFFU;
+
+        // size hash table so it is at most half full
+        // even if every vote goes to a different pixel
+        const size_t n_max = std::min(n_votes, static_cast<size_t>(rimg.total()));
+        size_t capacity = 64;
+        while (capacity < (2 * n_max))
+        {
+            capacity <<= 1;
+        }
+        const size_t mask = capacity - 1;
+
+        racc.img_sz = rimg.size();
+        racc.ct = 0;
+        racc.keys.assign(capacity, EMPTY);
+        racc.votes.assign(capacity, 0);
+
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = 1; j < (rimg.cols - 1); j++)
+            {
+                // look up voting table for pixel
+                // iterate through the points and add votes
+                uint8_t uu = pix[j];
+                T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                const size_t ct = rtable.elems[uu].ct;
+                for (size_t k = 0; k < ct; k++)
+                {
+                    // only vote if pixel is within output image bounds
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (j + rp.x);
+                    int my = (i + rp.y);
+                    if ((mx >= 0) && (mx < rimg.cols) &&
+                        (my >= 0) && (my < rimg.rows))
+                    {
+                        // multiplicative hash then linear probing
+                        const uint32_t key = static_cast<uint32_t>(my * rimg.cols + mx);
+                        size_t h = (key * 2654435761U) & mask;
+                        while ((racc.keys[h] != key) && (racc.keys[h] != EMPTY))
+                        {
+                            h = (h + 1) & mask;
+                        }
+                        if (racc.keys[h] == EMPTY)
+                        {
+                            racc.keys[h] = key;
+                            racc.ct++;
+                        }
+                        racc.votes[h] += pt_votes[k].votes;
+                    }
+                }
+            }
+        }
+    }
+
+
+    void apply_ghough_transform_sparse(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_sparse_acc& racc)
+    {
+        vote_sparse(rimg, rtable, count_ghough_votes(rimg, rtable), racc);
+    }
+
+
+    void find_sparse_acc_peak(
+        const BGHMatcher::T_ghough_sparse_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        uint32_t key_max = 0;
+        uint32_t votes_max = 0;
+        for (size_t h = 0; h < racc.keys.size(); h++)
+        {
+            const uint32_t v = racc.votes[h];
+            if ((v > votes_max) || ((v == votes_max) && (v > 0) && (racc.keys[h] < key_max)))
+            {
+                votes_max = v;
+                key_max = racc.keys[h];
+            }
+        }
+
+        const int cols = std::max(1, racc.img_sz.width);
+        rqmax = votes_max;
+        rptmax = { static_cast<int>(key_max % cols), static_cast<int>(key_max / cols) };
+    }
+
+
+    void convert_sparse_acc(
+        const BGHMatcher::T_ghough_sparse_acc& racc,
+        cv::Mat& rout)
+    {
+        rout = cv::Mat::zeros(racc.img_sz, CV_32F);
+        float * pout = rout.ptr<float>(0);
+        for (size_t h = 0; h < racc.keys.size(); h++)
+        {
+            if (racc.votes[h] > 0)
+            {
+                pout[racc.keys[h]] = static_cast<float>(racc.votes[h]);
+            }
+        }
+    }
+
+
+    bool find_ghough_match(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_sparse_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        const size_t n_votes = count_ghough_votes(rimg, rtable);
+        bool result = (n_votes * SPARSE_VOTE_RATIO) < rimg.total();
+        if (result)
+        {
+            vote_sparse(rimg, rtable, n_votes, racc);
+            find_sparse_acc_peak(racc, rqmax, rptmax);
+        }
+        else
+        {
+            cv::Mat img_match;
+            apply_ghough_transform_allpix<CV_32F, float>(rimg, img_match, rtable);
+            find_ghough_max(img_match, rqmax, rptmax);
+        }
+        return result;
+    }
+
+
+    void begin_lazy_acc(
+        BGHMatcher::T_ghough_lazy_acc& racc,
+        const cv::Size& rsz,
+        const int type)
+    {
+        // tile shift may have changed since the last epoch
+        // if the tile count is the same then the old tags are all stale anyway
+        const int tile_sz = 1 << racc.tile_shift;
+        const int tiles_x = (rsz.width + tile_sz - 1) / tile_sz;
+        const int tiles_y = (rsz.height + tile_sz - 1) / tile_sz;
+        if ((racc.data.size() != rsz) || (racc.data.type() != type) ||
+            (racc.tiles_x != tiles_x) || (racc.tiles_y != tiles_y))
+        {
+            racc.data.create(rsz, type);
+            racc.tiles_x = tiles_x;
+            racc.tiles_y = tiles_y;
+            racc.tile_epoch.assign(racc.tiles_x * racc.tiles_y, 0);
+            racc.epoch = 0;
+        }
+
+        // epoch 0 is never current so every tile starts out untouched
+        // and if the epoch counter wraps then all tags must be reset
+        racc.epoch++;
+        if (racc.epoch == 0)
+        {
+            std::fill(racc.tile_epoch.begin(), racc.tile_epoch.end(), 0);
+            racc.epoch = 1;
+        }
+    }
+
+
+    // gets rectangle for one tile of a lazy accumulator
+    static cv::Rect get_lazy_acc_tile_rect(
+        const BGHMatcher::T_ghough_lazy_acc& racc,
+        const int tile)
+    {
+        const int tile_sz = 1 << racc.tile_shift;
+        cv::Rect rect = {
+            (tile % racc.tiles_x) * tile_sz, (tile / racc.tiles_x) * tile_sz, tile_sz, tile_sz };
+        return rect & cv::Rect(0, 0, racc.data.cols, racc.data.rows);
+    }
+
+
+    void clear_lazy_acc_tile(
+        BGHMatcher::T_ghough_lazy_acc& racc,
+        const int tile)
+    {
+        racc.data(get_lazy_acc_tile_rect(racc, tile)).setTo(0);
+        racc.tile_epoch[tile] = racc.epoch;
+    }
+
+
+    void find_lazy_acc_peak(
+        const BGHMatcher::T_ghough_lazy_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        rqmax = 0.0;
+        rptmax = { 0, 0 };
+        bool is_found = false;
+        for (int tile = 0; tile < static_cast<int>(racc.tile_epoch.size()); tile++)
+        {
+            if (racc.tile_epoch[tile] != racc.epoch)
+            {
+                continue;
+            }
+
+            // tiles are visited in raster order of tiles, not pixels,
+            // so ties between tiles are resolved by comparing locations
+            double q;
+            cv::Point pt;
+            const cv::Rect rect = get_lazy_acc_tile_rect(racc, tile);
+            cv::minMaxLoc(racc.data(rect), nullptr, &q, nullptr, &pt);
+            pt += rect.tl();
+            if (!is_found || (q > rqmax) ||
+                ((q == rqmax) && ((pt.y < rptmax.y) || ((pt.y == rptmax.y) && (pt.x < rptmax.x)))))
+            {
+                rqmax = q;
+                rptmax = pt;
+                is_found = true;
+            }
+        }
+    }
+
+
+    void convert_lazy_acc(
+        const BGHMatcher::T_ghough_lazy_acc& racc,
+        cv::Mat& rout)
+    {
+        rout = cv::Mat::zeros(racc.data.size(), racc.data.type());
+        for (int tile = 0; tile < static_cast<int>(racc.tile_epoch.size()); tile++)
+        {
+            if (racc.tile_epoch[tile] == racc.epoch)
+            {
+                const cv::Rect rect = get_lazy_acc_tile_rect(racc, tile);
+                racc.data(rect).copyTo(rout(rect));
+            }
+        }
+    }
+
+
+    void init_tiled_acc(
+        BGHMatcher::T_ghough_tiled_acc& racc,
+        const cv::Size& rsz,
+        const int type)
+    {
+        const int tile_sz = 1 << racc.tile_shift;
+        racc.img_sz = rsz;
+        racc.tiles_x = (rsz.width + tile_sz - 1) / tile_sz;
+        racc.tiles_y = (rsz.height + tile_sz - 1) / tile_sz;
+        racc.data = cv::Mat::zeros(racc.tiles_x * racc.tiles_y, tile_sz * tile_sz, type);
+    }
+
+
+    void convert_tiled_acc(
+        const BGHMatcher::T_ghough_tiled_acc& racc,
+        cv::Mat& rout)
+    {
+        const int tile_sz = 1 << racc.tile_shift;
+        const cv::Rect rimg = { 0, 0, racc.img_sz.width, racc.img_sz.height };
+        rout.create(racc.img_sz, racc.data.type());
+        for (int ty = 0; ty < racc.tiles_y; ty++)
+        {
+            for (int tx = 0; tx < racc.tiles_x; tx++)
+            {
+                // view tile data as a small square image
+                // and crop it where it overhangs the image edge
+                const cv::Rect rect = cv::Rect(tx * tile_sz, ty * tile_sz, tile_sz, tile_sz) & rimg;
+                const cv::Mat tile = racc.data.row(ty * racc.tiles_x + tx).reshape(0, tile_sz);
+                tile(cv::Rect(0, 0, rect.width, rect.height)).copyTo(rout(rect));
+            }
+        }
+    }
+
+
+    void apply_ghough_transform_temporal(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_temporal& rstate)
+    {
+        // do a full vote if there is no valid history
+        // or if too many of the voting pixels have changed codes
+        bool is_full_vote = rstate.acc.empty() || (rstate.acc.size() != rimg.size());
+        if (!is_full_vote)
+        {
+            int n_changed = cv::countNonZero(rimg != rstate.prev_codes);
+            int n_voting = std::max(1, cv::countNonZero(rimg));
+            is_full_vote = ((static_cast<double>(n_changed) / n_voting) > rstate.change_thr);
+        }
+        rimg.copyTo(rstate.prev_codes);
+
+        if (is_full_vote)
+        {
+            apply_ghough_transform_allpix<CV_32F, float>(rimg, rstate.acc, rtable);
+        }
+        else
+        {
+            // sampled votes are already reweighted so a decaying average
+            // of them approximates a full vote
+            cv::Mat temp_votes;
+            T_ghough_sampling samp = rstate.samp;
+            samp.phase = static_cast<int>(rstate.frame_ct % get_sampling_factor(samp));
+            apply_ghough_transform_allpix<CV_32F, float>(rimg, temp_votes, rtable, samp);
+            cv::accumulateWeighted(temp_votes, rstate.acc, rstate.decay);
+        }
+
+        rstate.is_full_vote = is_full_vote;
+        rstate.frame_ct++;
+        rstate.acc.copyTo(rout);
+    }
+
+
+    void create_ghough_lowrank(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double target_err,
+        const int max_rank,
+        BGHMatcher::T_ghough_lowrank& rlowrank)
+    {
+        // all kernels share one size that covers every offset in the table
+        // the extent always includes the origin so the anchor is inside the kernel
+        const cv::Rect ext = get_ghough_table_extent(rtable);
+        rlowrank.params = rtable.params;
+        rlowrank.img_sz = rtable.img_sz;
+        rlowrank.ksize = ext.size();
+        rlowrank.anchor = { ext.width - 1 + ext.x, ext.height - 1 + ext.y };
+        rlowrank.total_votes = rtable.total_votes;
+        rlowrank.total_terms = 0;
+        rlowrank.kx.assign(rtable.elem_ct, cv::Mat());
+        rlowrank.ky.assign(rtable.elem_ct, cv::Mat());
+        rlowrank.ranks.assign(rtable.elem_ct, 0);
+        rlowrank.errs.assign(rtable.elem_ct, 0.0);
+
+        // decompose every code's kernel first so ranks can be chosen across all codes
+        std::vector<cv::SVD> vsvd(rtable.elem_ct);
+        std::vector<double> vsum_sq(rtable.elem_ct, 0.0);
+        double sum_sq_all = 0.0;
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            const T_ghough_elem& relem = rtable.elems[key];
+            if (relem.ct == 0)
+            {
+                continue;
+            }
+
+            // scatter entries into a dense kernel
+            // then flip it so a vote at p+d becomes a correlation
+            cv::Mat kernel = cv::Mat::zeros(ext.size(), CV_32F);
+            for (size_t k = 0; k < relem.ct; k++)
+            {
+                const cv::Point& rpt = relem.pt_votes[k].pt;
+                kernel.at<float>(rpt.y - ext.y, rpt.x - ext.x) += relem.pt_votes[k].votes;
+            }
+            cv::flip(kernel, kernel, -1);
+
+            vsvd[key](kernel);
+            for (int r = 0; r < vsvd[key].w.rows; r++)
+            {
+                double w = vsvd[key].w.at<float>(r);
+                vsum_sq[key] += w * w;
+            }
+            sum_sq_all += vsum_sq[key];
+        }
+
+        // at the template's own location every pixel of code c hits its kernel at its own offset
+        // so the exact peak is the sum of the squared kernels and the peak of a truncated SVD
+        // is smaller by exactly the energy of the dropped singular values
+        // taking terms in order of singular value across all codes meets the target
+        // relative score error with the fewest terms (every term costs the same)
+        typedef struct { double w_sq; size_t key; } T_term;
+        std::vector<T_term> vterms;
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            const int rank_limit = std::min(vsvd[key].w.rows, std::max(1, max_rank));
+            for (int r = 0; r < rank_limit; r++)
+            {
+                double w = vsvd[key].w.at<float>(r);
+                vterms.push_back({ w * w, key });
+            }
+        }
+        std::stable_sort(vterms.begin(), vterms.end(),
+            [](const T_term& a, const T_term& b) { return a.w_sq > b.w_sq; });
+
+        double res_sq_all = sum_sq_all;
+        for (const auto& rterm : vterms)
+        {
+            if (res_sq_all <= (target_err * sum_sq_all))
+            {
+                break;
+            }
+            res_sq_all -= rterm.w_sq;
+            rlowrank.ranks[rterm.key]++;
+        }
+
+        for (size_t key = 0; key < rtable.elem_ct; key++)
+        {
+            const int rank = rlowrank.ranks[key];
+            if (rank == 0)
+            {
+                rlowrank.errs[key] = (vsum_sq[key] > 0.0) ? 1.0 : 0.0;
+                continue;
+            }
+
+            // split each singular value evenly between row and column filters
+            const cv::SVD& rsvd = vsvd[key];
+            double res_sq = vsum_sq[key];
+            cv::Mat kx(rank, ext.width, CV_32F);
+            cv::Mat ky(rank, ext.height, CV_32F);
+            for (int r = 0; r < rank; r++)
+            {
+                double w = rsvd.w.at<float>(r);
+                res_sq -= w * w;
+                w = std::sqrt(w);
+                cv::Mat vrow = rsvd.vt.row(r) * w;
+                cv::Mat ucol = rsvd.u.col(r).t() * w;
+                vrow.copyTo(kx.row(r));
+                ucol.copyTo(ky.row(r));
+            }
+
+            rlowrank.kx[key] = kx;
+            rlowrank.ky[key] = ky;
+            rlowrank.errs[key] = std::max(0.0, res_sq) / vsum_sq[key];
+            rlowrank.total_terms += rank;
+        }
+
+        rlowrank.score_err = (sum_sq_all > 0.0) ? (std::max(0.0, res_sq_all) / sum_sq_all) : 0.0;
+    }
+
+
+    void apply_ghough_transform_lowrank(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_lowrank& rlowrank)
+    {
+        cv::Mat code_mask;
+        cv::Mat temp_mask;
+        cv::Mat temp_votes;
+
+        rout = cv::Mat::zeros(rimg.size(), CV_32F);
+        for (size_t key = 1; key < rlowrank.ranks.size(); key++)
+        {
+            const int rank = rlowrank.ranks[key];
+            if (rank == 0)
+            {
+                continue;
+            }
+
+            // mask of pixels with this code (1.0 or 0.0)
+            // votes outside the image are discarded by the constant border
+            temp_mask = (rimg == static_cast<double>(key));
+            temp_mask.convertTo(code_mask, CV_32F, 1.0 / 255.0);
+            for (int r = 0; r < rank; r++)
+            {
+                cv::sepFilter2D(
+                    code_mask, temp_votes, CV_32F,
+                    rlowrank.kx[key].row(r), rlowrank.ky[key].row(r),
+                    rlowrank.anchor, 0.0, cv::BORDER_CONSTANT);
+                rout += temp_votes;
+            }
+        }
+    }
+
+
+    void print_ghough_lowrank_report(
+        const BGHMatcher::T_ghough_lowrank& rlowrank,
+        std::ostream& ros)
+    {
+        ros << "Low-rank table " << rlowrank.ksize.width << "x" << rlowrank.ksize.height;
+        ros << "  terms=" << rlowrank.total_terms;
+        ros << "  err=" << std::fixed << std::setprecision(4) << rlowrank.score_err << std::endl;
+        for (size_t key = 0; key < rlowrank.ranks.size(); key++)
+        {
+            if (rlowrank.ranks[key] > 0)
+            {
+                ros << "  code " << std::setw(3) << key;
+                ros << "  rank=" << std::setw(3) << rlowrank.ranks[key];
+                ros << "  err=" << std::fixed << std::setprecision(4) << rlowrank.errs[key] << std::endl;
+            }
+        }
+    }
+
+
+    // creates mask of pixels whose gradient magnitude is a local maximum
+    // along the gradient direction, the direction is quantized to 4 lines
+    // so each pixel is compared with 2 of its 8 neighbors
+    static void create_nms_mask(
+        const cv::Mat& rmag,
+        const cv::Mat& rang,
+        const int tol,
+        cv::Mat& rmask)
+    {
+        // neighbor offsets for horizontal, diagonal, vertical, anti-diagonal lines
+        const int di[4] = { 0, 1, 1, 1 };
+        const int dj[4] = { 1, 1, 0, -1 };
+
+        rmask = cv::Mat::zeros(rmag.size(), CV_8U);
+        for (int i = 1; i < (rmag.rows - 1); i++)
+        {
+            const float * pmag = rmag.ptr<float>(i);
+            const float * pang = rang.ptr<float>(i);
+            uint8_t * pmask = rmask.ptr<uint8_t>(i);
+            for (int j = 1; j < (rmag.cols - 1); j++)
+            {
+                const int n = cvRound(pang[j] * (4.0 / CV_PI)) & 3;
+                const float m = pmag[j];
+                const float ma = rmag.ptr<float>(i + di[n])[j + dj[n]];
+                const float mb = rmag.ptr<float>(i - di[n])[j - dj[n]];
+                if ((m >= ma) && (m >= mb))
+                {
+                    pmask[j] = 255;
+                }
+            }
+        }
+
+        // optionally thicken the thinned edges
+        if (tol > 0)
+        {
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, { 2 * tol + 1, 2 * tol + 1 });
+            cv::dilate(rmask, rmask, kernel);
+        }
+    }
+
+
+    int get_ghough_code_ct(
+        const BGHMatcher::T_ghough_params& rparams)
+    {
+        // an angle of 2pi gets the code that wraps to 1 so the codes before it are 1 to N
+        // compute it the same way the encoder does (float scale then round)
+        const float scale = static_cast<float>(get_ang_step(rparams) / CV_2PI);
+        return cvRound(static_cast<float>(CV_2PI) * scale + 1.0f) - 1;
+    }
+
+
+    void create_rotated_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const double angle,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        create_posed_ghough_table(rsrc, 1.0, angle, rtable);
+    }
+
+
+    void create_posed_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const double scale,
+        const double angle,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        const int n = get_ghough_code_ct(rsrc.params);
+        const int shift = cvRound(angle * n / CV_2PI);
+
+        // gradient orientations are not changed by scaling
+        // so only the offsets are scaled
+        T_lookup_map lookup_table;
+        add_posed_entries(rsrc, scale, angle, shift, n, lookup_table);
+
+        // rotated object needs a bigger box
+        const double ca = std::fabs(std::cos(angle));
+        const double sa = std::fabs(std::sin(angle));
+        const cv::Size img_sz = {
+            cvCeil(rsrc.img_sz.width * ca + rsrc.img_sz.height * sa),
+            cvCeil(rsrc.img_sz.width * sa + rsrc.img_sz.height * ca) };
+
+        // source and destination may be the same table
+        // so save metadata before the destination is cleared
+        // (box size stays unscaled like a table made with a scale parameter)
+        T_ghough_params params = rsrc.params;
+        params.scale *= scale;
+        const T_ghough_symmetry sym = rsrc.sym;
+        const int bin = rsrc.bin;
+        fill_ghough_table(lookup_table, img_sz, rtable);
+        rtable.params = params;
+        rtable.sym = sym;
+        rtable.bin = bin;
+    }
+
+
+    void create_union_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const std::vector<BGHMatcher::T_ghough_pose>& rposes,
+        const int cap,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        const int n = get_ghough_code_ct(rsrc.params);
+
+        // merge entries of every pose in one lookup table
+        // and get a box big enough for every pose
+        T_lookup_map lookup_table;
+        cv::Size img_sz = rsrc.img_sz;
+        double scale_max = 1.0;
+        for (const auto& rpose : rposes)
+        {
+            const int shift = cvRound(rpose.angle * n / CV_2PI);
+            add_posed_entries(rsrc, rpose.scale, rpose.angle, shift, n, lookup_table);
+
+            const double ca = std::fabs(std::cos(rpose.angle));
+            const double sa = std::fabs(std::sin(rpose.angle));
+            img_sz.width = std::max(img_sz.width, cvCeil(rsrc.img_sz.width * ca + rsrc.img_sz.height * sa));
+            img_sz.height = std::max(img_sz.height, cvCeil(rsrc.img_sz.width * sa + rsrc.img_sz.height * ca));
+            scale_max = std::max(scale_max, rpose.scale);
+        }
+
+        // optional cap keeps offsets shared by many poses from dominating
+        if (cap > 0)
+        {
+            for (auto& r : lookup_table)
+            {
+                for (auto& rr : r.second)
+                {
+                    rr.second = static_cast<uint16_t>(std::min<int>(cap, rr.second));
+                }
+            }
+        }
+
+        // source and destination may be the same table
+        // so save metadata before the destination is cleared
+        T_ghough_params params = rsrc.params;
+        params.scale *= scale_max;
+        const T_ghough_symmetry sym = rsrc.sym;
+        const int bin = rsrc.bin;
+        fill_ghough_table(lookup_table, img_sz, rtable);
+        rtable.params = params;
+        rtable.sym = sym;
+        rtable.bin = bin;
+    }
+
+
+    void analyze_ghough_symmetry(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double thr,
+        BGHMatcher::T_ghough_symmetry& rsym)
+    {
+        const int n = get_ghough_code_ct(rtable.params);
+
+        // put table in a searchable structure
+        T_lookup_map lookup_table;
+        add_posed_entries(rtable, 1.0, 0.0, 0, n, lookup_table);
+
+        T_ghough_symmetry sym;
+        sym.code_shift = n;
+        for (int m = 1; m < n; m++)
+        {
+            // skip rotations that do not evenly divide a full circle
+            if (n % m)
+            {
+                continue;
+            }
+
+            // rotate every entry and see if the original table has votes
+            // at the same code and offset (or a neighbor of the offset)
+            const double angle = (CV_2PI * m) / n;
+            const double ca = std::cos(angle);
+            const double sa = std::sin(angle);
+            double matched = 0.0;
+            double total = 0.0;
+            for (const auto& r : lookup_table)
+            {
+                const auto iter_dst = lookup_table.find(shift_code(r.first, m, n));
+                for (const auto& rr : r.second)
+                {
+                    const cv::Point& rpt = rr.first;
+                    cv::Point offset_pt = {
+                        cvRound(ca * rpt.x - sa * rpt.y),
+                        cvRound(sa * rpt.x + ca * rpt.y) };
+                    int votes_max = 0;
+                    for (int di = -1; (di <= 1) && (iter_dst != lookup_table.end()); di++)
+                    {
+                        for (int dj = -1; dj <= 1; dj++)
+                        {
+                            const auto& rdst = iter_dst->second;
+                            auto iter = rdst.find(offset_pt + cv::Point(dj, di));
+                            if (iter != rdst.end())
+                            {
+                                votes_max = std::max<int>(votes_max, iter->second);
+                            }
+                        }
+                    }
+                    matched += std::min<int>(votes_max, rr.second);
+                    total += rr.second;
+                }
+            }
+
+            // smallest symmetric rotation determines the order
+            const double score = (total > 0.0) ? (matched / total) : 0.0;
+            if (score >= thr)
+            {
+                sym.order = n / m;
+                sym.code_shift = m;
+                sym.angle = angle;
+                sym.score = score;
+                break;
+            }
+        }
+
+        rsym = sym;
+    }
+
+
+    void compress_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        const int n = get_ghough_code_ct(rsrc.params);
+        const int max_code = (rsrc.sym.order > 1) ? rsrc.sym.code_shift : n;
+
+        T_lookup_map lookup_table;
+        if (rsrc.sym.order > 1)
+        {
+            add_posed_entries(rsrc, 1.0, 0.0, 0, max_code, lookup_table);
+        }
+        else
+        {
+            add_entries(rsrc, lookup_table);
+        }
+
+        // source and destination may be the same table
+        // so save metadata before the destination is cleared
+        const T_ghough_params params = rsrc.params;
+        const T_ghough_symmetry sym = rsrc.sym;
+        const int bin = rsrc.bin;
+        fill_ghough_table(lookup_table, rsrc.img_sz, rtable);
+        rtable.is_compressed = (sym.order > 1);
+        rtable.params = params;
+        rtable.sym = sym;
+        rtable.bin = bin;
+    }
+
+
+    void expand_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable)
+    {
+        const int n = get_ghough_code_ct(rsrc.params);
+        const int order = std::max(1, rsrc.sym.order);
+
+        // canonical codes are rotated through the full circle
+        T_lookup_map lookup_table;
+        for (int k = 0; k < order; k++)
+        {
+            add_posed_entries(rsrc, 1.0, k * rsrc.sym.angle, k * rsrc.sym.code_shift, n, lookup_table);
+        }
+
+        // source and destination may be the same table
+        // so save metadata before the destination is cleared
+        const T_ghough_params params = rsrc.params;
+        const T_ghough_symmetry sym = rsrc.sym;
+        const int bin = rsrc.bin;
+        fill_ghough_table(lookup_table, rsrc.img_sz, rtable);
+        rtable.params = params;
+        rtable.sym = sym;
+        rtable.bin = bin;
+    }
+
+
+    // sorts changes by code then by offset
+    static void sort_ghough_delta(
+        const std::vector<BGHMatcher::T_ghough_delta>& rdelta,
+        std::vector<BGHMatcher::T_ghough_delta>& rsorted)
+    {
+        rsorted = rdelta;
+        std::stable_sort(rsorted.begin(), rsorted.end(),
+            [](const T_ghough_delta& a, const T_ghough_delta& b)
+        {
+            return (a.code < b.code) || ((a.code == b.code) && cmpCvPoint()(a.pt, b.pt));
+        });
+    }
+
+
+    // finds entry with an offset in a sorted range of entries
+    // returns end of range if it isn't there
+    static size_t find_ghough_entry(
+        const BGHMatcher::T_pt_votes * pt_votes,
+        const size_t k0,
+        const size_t k1,
+        const cv::Point& rpt)
+    {
+        const T_pt_votes * pbegin = pt_votes + k0;
+        const T_pt_votes * pend = pt_votes + k1;
+        const T_pt_votes * p = std::lower_bound(pbegin, pend, rpt,
+            [](const T_pt_votes& a, const cv::Point& b) { return cmpCvPoint()(a.pt, b); });
+        return ((p != pend) && (p->pt == rpt)) ? static_cast<size_t>(p - pt_votes) : k1;
+    }
+
+
+    // finds entry with an offset in an element
+    // sorted part and sorted tail are searched separately
+    // returns entry count if it isn't there
+    static size_t find_ghough_entry(
+        const BGHMatcher::T_ghough_elem& relem,
+        const cv::Point& rpt)
+    {
+        const size_t sorted_ct = relem.ct - relem.tail_ct;
+        const size_t k = find_ghough_entry(relem.pt_votes, 0, sorted_ct, rpt);
+        return (k < sorted_ct) ? k : find_ghough_entry(relem.pt_votes, sorted_ct, relem.ct, rpt);
+    }
+
+
+    // merges the sorted tail of an element into its sorted part and squeezes out entries with no votes
+    // (capacity is kept)
+    static void merge_ghough_elem(
+        BGHMatcher::T_ghough_elem& relem)
+    {
+        auto cmp = [](const T_pt_votes& a, const T_pt_votes& b) { return cmpCvPoint()(a.pt, b.pt); };
+        T_pt_votes * pmid = relem.pt_votes + (relem.ct - relem.tail_ct);
+        T_pt_votes * pend = relem.pt_votes + relem.ct;
+        std::inplace_merge(relem.pt_votes, pmid, pend, cmp);
+
+        size_t ct = 0;
+        for (size_t k = 0; k < relem.ct; k++)
+        {
+            if (relem.pt_votes[k].votes)
+            {
+                relem.pt_votes[ct++] = relem.pt_votes[k];
+            }
+        }
+        relem.ct = ct;
+        relem.tail_ct = 0;
+        relem.dead_ct = 0;
+    }
+
+
+    // merges an element once its tail or its empty entries pass a fraction of its entries
+    // so the full cost of a merge is spread over many edits
+    static void update_ghough_elem(
+        BGHMatcher::T_ghough_elem& relem)
+    {
+        const size_t lim = relem.ct / EDIT_MERGE_RATIO;
+        if ((relem.tail_ct > lim) || (relem.dead_ct > lim))
+        {
+            merge_ghough_elem(relem);
+        }
+    }
+
+
+    bool insert_ghough_entries(
+        BGHMatcher::T_ghough_table& rtable,
+        const std::vector<BGHMatcher::T_ghough_delta>& rdelta)
+    {
+        if (rtable.is_view)
+        {
+            return false;
+        }
+
+        std::vector<T_ghough_delta> vsorted;
+        sort_ghough_delta(rdelta, vsorted);
+
+        // make room for new codes
+        // element entries are moved (not copied) into bigger element array
+        const size_t elem_ct = (vsorted.empty()) ? 0 : (static_cast<size_t>(vsorted.back().code) + 1);
+        if (elem_ct > rtable.elem_ct)
+        {
+            T_ghough_elem * elems = new T_ghough_elem[elem_ct];
+            for (size_t key = 0; key < rtable.elem_ct; key++)
+            {
+                elems[key].ct = rtable.elems[key].ct;
+                elems[key].cap = rtable.elems[key].cap;
+                elems[key].tail_ct = rtable.elems[key].tail_ct;
+                elems[key].dead_ct = rtable.elems[key].dead_ct;
+                elems[key].pt_votes = rtable.elems[key].pt_votes;
+                rtable.elems[key].pt_votes = nullptr;
+            }
+            delete[] rtable.elems;
+            rtable.elems = elems;
+            rtable.elem_ct = elem_ct;
+        }
+
+        size_t a = 0;
+        while (a < vsorted.size())
+        {
+            const uint8_t code = vsorted[a].code;
+            T_ghough_elem& relem = rtable.elems[code];
+
+            // update existing entries (maybe empty ones) in place
+            // and collect new ones in sorted order (changes for same offset are combined)
+            std::vector<T_pt_votes> vnew;
+            for (; (a < vsorted.size()) && (vsorted[a].code == code); a++)
+            {
+                const T_ghough_delta& rd = vsorted[a];
+                if (rd.votes == 0)
+                {
+                    continue;
+                }
+
+                const size_t k = find_ghough_entry(relem, rd.pt);
+                uint16_t * pvotes = nullptr;
+                if (k < relem.ct)
+                {
+                    pvotes = &relem.pt_votes[k].votes;
+                    relem.dead_ct -= (*pvotes == 0) ? 1 : 0;
+                    rtable.total_entries += (*pvotes == 0) ? 1 : 0;
+                }
+                else
+                {
+                    if (vnew.empty() || (vnew.back().pt != rd.pt))
+                    {
+                        vnew.push_back(T_pt_votes(rd.pt, 0));
+                        rtable.total_entries++;
+                    }
+                    pvotes = &vnew.back().votes;
+                }
+
+                // saturation may keep some votes from being added
+                const uint16_t votes0 = *pvotes;
+                add_votes(*pvotes, rd.votes);
+                rtable.total_votes += (*pvotes - votes0);
+            }
+
+            if (!vnew.empty())
+            {
+                // grow with slack so next insert probably fits
+                const size_t ct = relem.ct + vnew.size();
+                if (ct > relem.cap)
+                {
+                    const size_t cap = std::max(ct, 2 * relem.cap);
+                    T_pt_votes * pt_votes = new T_pt_votes[cap];
+                    std::copy(relem.pt_votes, relem.pt_votes + relem.ct, pt_votes);
+                    delete[] relem.pt_votes;
+                    relem.pt_votes = pt_votes;
+                    relem.cap = cap;
+                }
+
+                // new entries are merged into the sorted tail once per call
+                // and the tail is merged into the sorted part below when it gets too big
+                std::copy(vnew.begin(), vnew.end(), relem.pt_votes + relem.ct);
+                std::inplace_merge(
+                    relem.pt_votes + (relem.ct - relem.tail_ct), relem.pt_votes + relem.ct, relem.pt_votes + ct,
+                    [](const T_pt_votes& a, const T_pt_votes& b) { return cmpCvPoint()(a.pt, b.pt); });
+                relem.ct = ct;
+                relem.tail_ct += vnew.size();
+            }
+
+            update_ghough_elem(relem);
+        }
+
+        return true;
+    }
+
+
+    bool remove_ghough_entries(
+        BGHMatcher::T_ghough_table& rtable,
+        const std::vector<BGHMatcher::T_ghough_delta>& rdelta)
+    {
+        if (rtable.is_view)
+        {
+            return false;
+        }
 
-        // calculate centering offset
-        int row_offset = rgrad.rows / 2;
-        int col_offset = rgrad.cols / 2;
+        std::vector<T_ghough_delta> vsorted;
+        sort_ghough_delta(rdelta, vsorted);
 
-        // iterate through the gradient image pixel-by-pixel
-        // use STL structures to build a lookup table dynamically
-        uint8_t max_code = 0;
-        std::map<uint8_t, std::map<cv::Point, uint16_t, cmpCvPoint>> lookup_table;
-        for (int i = 0; i < rgrad.rows; i++)
+        size_t a = 0;
+        while (a < vsorted.size())
         {
-            const uint8_t * pix = rgrad.ptr<uint8_t>(i);
-            for (int j = 0; j < rgrad.cols; j++)
+            const uint8_t code = vsorted[a].code;
+            if (code >= rtable.elem_ct)
             {
-                // get the gradient pixel value (key)
-                // everything non-zero is valid
-                const uint8_t uu = pix[j];
-                if (uu)
+                break;
+            }
+
+            // take votes away and leave an entry that runs out in place
+            T_ghough_elem& relem = rtable.elems[code];
+            for (; (a < vsorted.size()) && (vsorted[a].code == code); a++)
+            {
+                const size_t k = find_ghough_entry(relem, vsorted[a].pt);
+                if ((k < relem.ct) && relem.pt_votes[k].votes)
                 {
-                    // the scaling operation can make one point have multiple votes
-                    // so the vote count is mapped to a point and incremented
-                    cv::Point offset_pt = cv::Point(col_offset - j, row_offset - i);
-                    offset_pt.x = static_cast<int>(fac * offset_pt.x);
-                    offset_pt.y = static_cast<int>(fac * offset_pt.y);
-                    lookup_table[uu][offset_pt]++;
-                    max_code = (uu > max_code) ? uu : max_code;
+                    uint16_t& rvotes = relem.pt_votes[k].votes;
+                    const uint16_t n = std::min(rvotes, vsorted[a].votes);
+                    rvotes -= n;
+                    rtable.total_votes -= n;
+                    if (rvotes == 0)
+                    {
+                        relem.dead_ct++;
+                        rtable.total_entries--;
+                    }
                 }
             }
+
+            update_ghough_elem(relem);
         }
 
-        // add blank entry for any code not in map for codes 0-max
-        for (uint8_t key = 0; key <= max_code; key++)
+        return true;
+    }
+
+
+    void get_ghough_search_angles(
+        const BGHMatcher::T_ghough_symmetry& rsym,
+        const double angle_step,
+        std::vector<double>& rangles)
+    {
+        // only angles up to the smallest symmetric rotation are unique
+        const double angle_max = (rsym.order > 1) ? rsym.angle : CV_2PI;
+        rangles.clear();
+        for (int k = 0; (k * angle_step) < (angle_max - 1.0e-6); k++)
+        {
+            rangles.push_back(k * angle_step);
+        }
+    }
+
+
+    // keeps the best hypotheses, skipping any with the same pose as a better one
+    static void keep_best_poses(
+        std::vector<BGHMatcher::T_ghough_pose>& rposes,
+        const size_t n)
+    {
+        std::stable_sort(rposes.begin(), rposes.end(),
+            [](const T_ghough_pose& a, const T_ghough_pose& b) { return a.score > b.score; });
+        std::vector<T_ghough_pose> vbest;
+        for (const auto& rpose : rposes)
         {
-            if (lookup_table.count(key) == 0)
+            bool is_dup = false;
+            for (const auto& rbest : vbest)
+            {
+                is_dup = is_dup ||
+                    ((std::fabs(rpose.scale - rbest.scale) < 1.0e-6) &&
+                    (std::fabs(rpose.angle - rbest.angle) < 1.0e-6));
+            }
+            if (!is_dup && (vbest.size() < n))
             {
-                lookup_table[key] = {};
+                vbest.push_back(rpose);
             }
         }
-        
-        // blow away any old data in table
-        rtable.clear();
+        rposes = vbest;
+    }
 
-        // then put lookup table into a fixed non-STL structure
-        // that is much more efficient when running debug code
-        rtable.img_sz = rgrad.size();
-        rtable.elem_ct = lookup_table.size();
-        rtable.elems = new T_ghough_elem[rtable.elem_ct];
-        for (const auto& r : lookup_table)
+
+    void create_ghough_pose_grid(
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_pose_search& rsearch,
+        BGHMatcher::T_ghough_pose_grid& rgrid)
+    {
+        std::vector<double> vangles;
+        get_ghough_search_angles(rtable.sym, rsearch.angle_step, vangles);
+
+        // scales are evenly spaced in log scale
+        const int scale_ct = std::max(1, rsearch.scale_ct);
+        std::vector<double> vscales;
+        for (int k = 0; k < scale_ct; k++)
         {
-            uint8_t key = r.first;
-            size_t n = r.second.size();
-            if (n > 0)
+            const double f = (scale_ct > 1) ? (static_cast<double>(k) / (scale_ct - 1)) : 0.0;
+            vscales.push_back(rsearch.scale_min * std::pow(rsearch.scale_max / rsearch.scale_min, f));
+        }
+
+        rgrid.search = rsearch;
+        rgrid.poses.clear();
+        for (const auto& rscale : vscales)
+        {
+            for (const auto& rangle : vangles)
             {
-                rtable.elems[key].ct = n;
-                rtable.elems[key].pt_votes = new T_pt_votes[n];
-                size_t k = 0;
-                for (const auto& rr : r.second)
+                T_ghough_pose pose;
+                pose.scale = rscale;
+                pose.angle = rangle;
+                rgrid.poses.push_back(pose);
+            }
+        }
+
+        // tables can't be copied so they are built in place
+        rgrid.refine_tables.clear();
+        rgrid.tables.clear();
+        rgrid.tables.resize(rgrid.poses.size());
+        for (size_t k = 0; k < rgrid.poses.size(); k++)
+        {
+            create_posed_ghough_table(rtable, rgrid.poses[k].scale, rgrid.poses[k].angle, rgrid.tables[k]);
+        }
+    }
+
+
+    // gets refinement table for a pose from the grid cache and builds it on first use
+    // map nodes never move and a table is never changed after it is built
+    // so the table stays valid until the cache is emptied by the next search
+    static const T_ghough_table& get_refine_ghough_table(
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_pose_grid& rgrid,
+        const double scale,
+        const double angle)
+    {
+        const std::pair<long long, long long> key(
+            std::llround(std::log(scale) * 1.0e6), std::llround(angle * 1.0e6));
+        auto iter = rgrid.refine_tables.find(key);
+        if (iter == rgrid.refine_tables.end())
+        {
+            T_ghough_table& rnew = rgrid.refine_tables[key];
+            create_posed_ghough_table(rtable, scale, angle, rnew);
+            return rnew;
+        }
+        return iter->second;
+    }
+
+
+    void search_ghough_pose(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_pose_grid& rgrid,
+        cv::Mat& rout,
+        std::vector<BGHMatcher::T_ghough_pose>& rposes)
+    {
+        const T_ghough_pose_search& rsearch = rgrid.search;
+        const size_t top_ct = static_cast<size_t>(std::max(1, rsearch.top_ct));
+
+        // a cache that has grown past its cap is emptied before any of its tables are used
+        if (rgrid.refine_tables.size() > rsearch.refine_cap)
+        {
+            rgrid.refine_tables.clear();
+        }
+
+        // coarse level votes over the whole image with every grid table
+        // and the match image of the best one is kept
+        cv::Mat img_match;
+        double score_max = -1.0;
+        rposes.clear();
+        for (size_t k = 0; k < rgrid.tables.size(); k++)
+        {
+            T_ghough_pose pose = rgrid.poses[k];
+            apply_ghough_transform_allpix<CV_32F, float>(rimg, img_match, rgrid.tables[k]);
+            find_ghough_max(img_match, pose.qmax, pose.pt);
+            pose.score = pose.qmax / std::max<size_t>(1, rgrid.tables[k].total_votes);
+            rposes.push_back(pose);
+            if (pose.score > score_max)
+            {
+                score_max = pose.score;
+                rout = img_match;
+                img_match = cv::Mat();
+            }
+        }
+        keep_best_poses(rposes, top_ct);
+
+        // step sizes of the coarse grid
+        const int scale_ct = std::max(1, rsearch.scale_ct);
+        const double scale_ratio = (scale_ct > 1) ?
+            std::pow(rsearch.scale_max / rsearch.scale_min, 1.0 / (scale_ct - 1)) : 1.0;
+        const double angle_max = (rtable.sym.order > 1) ? rtable.sym.angle : CV_2PI;
+        const cv::Rect rect_img = { 0, 0, rimg.cols, rimg.rows };
+
+        // each level tries the neighbors of the survivors with half the step size
+        // votes are only counted in a small region around each survivor
+        for (int level = 1; level <= rsearch.levels; level++)
+        {
+            const double fs = std::pow(scale_ratio, 1.0 / (1 << level));
+            const double da = rsearch.angle_step / (1 << level);
+            std::vector<T_ghough_pose> vcand = rposes;
+            for (const auto& rpose : rposes)
+            {
+                const cv::Rect roi = cv::Rect(
+                    rpose.pt.x - rsearch.radius, rpose.pt.y - rsearch.radius,
+                    2 * rsearch.radius + 1, 2 * rsearch.radius + 1) & rect_img;
+                for (int ks = -1; ks <= 1; ks++)
                 {
-                    cv::Point pt = rr.first;
-                    rtable.elems[key].pt_votes[k++] = { pt, rr.second };
-                    rtable.total_votes += rr.second;
-                    rtable.total_entries++;
+                    for (int ka = -1; ka <= 1; ka++)
+                    {
+                        // skip center (already scored) and scales that would not change
+                        if (((ks == 0) && (ka == 0)) || ((ks != 0) && (scale_ct < 2)))
+                        {
+                            continue;
+                        }
+
+                        T_ghough_pose pose;
+                        pose.scale = rpose.scale * std::pow(fs, ks);
+                        pose.scale = std::max(rsearch.scale_min, std::min(rsearch.scale_max, pose.scale));
+                        pose.angle = std::fmod(rpose.angle + ka * da + angle_max, angle_max);
+
+                        const T_ghough_table& table = get_refine_ghough_table(rtable, rgrid, pose.scale, pose.angle);
+                        apply_ghough_transform_roi<CV_32F, float>(rimg, img_match, table, roi);
+                        find_ghough_max(img_match, pose.qmax, pose.pt);
+                        pose.pt += roi.tl();
+                        pose.score = pose.qmax / std::max<size_t>(1, table.total_votes);
+                        vcand.push_back(pose);
+                    }
                 }
             }
+            rposes = vcand;
+            keep_best_poses(rposes, top_ct);
         }
     }
 
-    
+
+    // finds a gradient magnitude threshold that leaves at most N pixels
+    // a histogram of the magnitudes is scanned from the top bin down
+    // and only pixels in the optional mask are counted
+    static double get_budget_mag_thr(
+        const cv::Mat& rmag,
+        const cv::Mat& rmask,
+        const double qmax,
+        const int n)
+    {
+        const int BINS = 1024;
+        if (qmax <= 0.0)
+        {
+            return 0.0;
+        }
+
+        std::vector<int> hist(BINS + 1, 0);
+        const double fac = BINS / qmax;
+        for (int i = 0; i < rmag.rows; i++)
+        {
+            const float * pmag = rmag.ptr<float>(i);
+            const uint8_t * pmask = (rmask.empty()) ? nullptr : rmask.ptr<uint8_t>(i);
+            for (int j = 0; j < rmag.cols; j++)
+            {
+                if (!pmask || pmask[j])
+                {
+                    hist[std::min(BINS, static_cast<int>(pmag[j] * fac))]++;
+                }
+            }
+        }
+
+        // every pixel in bins at or above the cut has magnitude >= the cut
+        // so a "greater than" threshold at the cut can never exceed the budget
+        int sum = 0;
+        int bin = BINS + 1;
+        while ((bin > 0) && ((sum + hist[bin - 1]) <= n))
+        {
+            bin--;
+            sum += hist[bin];
+        }
+        return bin / fac;
+    }
+
+
     void create_masked_gradient_orientation_img(
         const cv::Mat& rimg,
         cv::Mat& rmgo,
@@ -122,7 +1641,7 @@ namespace BGHMatcher
     {
         double qmax;
         double qmin;
-        double ang_step = rparams.ang_step;
+        double ang_step;
         cv::Mat temp_dx;
         cv::Mat temp_dy;
         cv::Mat temp_mag;
@@ -137,44 +1656,388 @@ namespace BGHMatcher
         // convert X-Y gradients to magnitude and angle
         cartToPolar(temp_dx, temp_dy, temp_mag, temp_ang);
 
+        // optionally thin the edges to reduce number of voting pixels
+        cv::Mat temp_nms;
+        if (rparams.nms_tol >= 0)
+        {
+            create_nms_mask(temp_mag, temp_ang, rparams.nms_tol, temp_nms);
+        }
+
         // create mask for pixels that exceed gradient magnitude threshold
+        // optionally raise the threshold to limit the number of voting pixels
         minMaxLoc(temp_mag, nullptr, &qmax);
-        temp_mask = (temp_mag > (qmax * rparams.mag_thr));
+        double mag_thr = qmax * rparams.mag_thr;
+        if (rparams.max_vote_pix > 0)
+        {
+            mag_thr = std::max(mag_thr, get_budget_mag_thr(temp_mag, temp_nms, qmax, rparams.max_vote_pix));
+        }
+        temp_mask = (temp_mag > mag_thr);
+        if (!temp_nms.empty())
+        {
+            temp_mask &= temp_nms;
+        }
 
         // scale, offset, and convert the angle image so 0-2pi becomes integers 1 to (ANG_STEP+1)
         // note that the angle can sometimes be 2pi which is equivalent to an angle of 0
+        // so code (ANG_STEP+1) is changed to 1 to keep each orientation in a single code
         // for some binary source images not all gradient codes may be generated
-        ang_step = (ang_step > ANG_STEP_MAX) ? ANG_STEP_MAX : ang_step;
-        ang_step = (ang_step < ANG_STEP_MIN) ? ANG_STEP_MIN: ang_step;
-        temp_ang.convertTo(rmgo, CV_8U, ang_step / (CV_2PI), 1.0);
+        // the selected row encoder (scalar or vector) applies the mask
+        // angle steps of exactly 8, 16, 32, or 64 use an encoder with a compile-time scale
+        // and a bit mask for the wrap like the coded voting kernels (same result)
+        const T_simd_kernels& rk = get_simd_kernels();
+        ang_step = get_ang_step(rparams);
+        const float scale = static_cast<float>(ang_step / (CV_2PI));
+        const int code_ct = get_ghough_code_ct(rparams);
+        const int ncoded = (is_ghough_params_coded(rparams)) ? get_simd_coded_index(code_ct) : -1;
+        rmgo.create(temp_ang.size(), CV_8U);
+        for (int i = 0; i < temp_ang.rows; i++)
+        {
+            if (ncoded >= 0)
+            {
+                rk.encode_row_coded[ncoded](
+                    temp_ang.ptr<float>(i), temp_mask.ptr<uint8_t>(i), rmgo.ptr<uint8_t>(i), temp_ang.cols);
+            }
+            else
+            {
+                rk.encode_row(
+                    temp_ang.ptr<float>(i), temp_mask.ptr<uint8_t>(i), rmgo.ptr<uint8_t>(i),
+                    temp_ang.cols, scale, code_ct);
+            }
+        }
+    }
+
+
+    void init_ghough_reduction(
+        const cv::Size& rsz,
+        BGHMatcher::T_ghough_reduction& rred)
+    {
+        rred.best = cv::Mat(rsz, CV_32F, cv::Scalar(-1.0));
+        rred.id = cv::Mat(rsz, CV_16U, cv::Scalar(0xFFFF));
+    }
+
+
+    void fold_ghough_reduction(
+        const cv::Mat& rvotes,
+        const cv::Rect& rroi,
+        const size_t total_votes,
+        const uint16_t id,
+        BGHMatcher::T_ghough_reduction& rred)
+    {
+        if (rvotes.type() == CV_32F)
+        {
+            const T_simd_kernels& rk = get_simd_kernels();
+            const float scale = static_cast<float>(1.0 / std::max<size_t>(1, total_votes));
+            for (int i = 0; i < rroi.height; i++)
+            {
+                rk.fold_row(
+                    rvotes.ptr<float>(i),
+                    rred.best.ptr<float>(rroi.y + i) + rroi.x,
+                    rred.id.ptr<uint16_t>(rroi.y + i) + rroi.x,
+                    rroi.width, scale, id);
+            }
+            return;
+        }
+
+        cv::Mat score;
+        rvotes.convertTo(score, CV_32F, 1.0 / std::max<size_t>(1, total_votes));
+        cv::Mat best_roi = rred.best(rroi);
+        cv::Mat id_roi = rred.id(rroi);
+        const cv::Mat mask = (score > best_roi);
+        score.copyTo(best_roi, mask);
+        id_roi.setTo(id, mask);
+    }
+
+
+    void reduce_ghough_hypotheses(
+        const cv::Mat& rimg,
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        const int band_rows,
+        BGHMatcher::T_ghough_reduction& rred)
+    {
+        // 0xFFFF is the id for no hypothesis
+        CV_Assert(rvtables.size() < 0xFFFF);
+        cv::Mat img_band;
+        init_ghough_reduction(rimg.size(), rred);
+        for (size_t k = 0; k < rvtables.size(); k++)
+        {
+            // a band scans its rows plus the extent height so a band shorter
+            // than the extent would spend most of its time rescanning rows
+            const cv::Rect ext = get_ghough_table_extent(*rvtables[k]);
+            const int h = std::max(std::max(1, band_rows), ext.height);
+            for (int r0 = 0; r0 < rimg.rows; r0 += h)
+            {
+                const cv::Rect roi = { 0, r0, rimg.cols, std::min(h, rimg.rows - r0) };
+                apply_ghough_transform_roi<CV_32F, float>(rimg, img_band, *rvtables[k], roi);
+                fold_ghough_reduction(img_band, roi, rvtables[k]->total_votes, static_cast<uint16_t>(k), rred);
+            }
+        }
+    }
+
+
+    bool find_ghough_reduction_peak(
+        const BGHMatcher::T_ghough_reduction& rred,
+        BGHMatcher::T_ghough_peak& rpeak,
+        uint16_t& rid)
+    {
+        rpeak = T_ghough_peak();
+        rid = 0xFFFF;
+        if (rred.best.empty())
+        {
+            return false;
+        }
+
+        find_ghough_max(rred.best, rpeak.score, rpeak.ptmax);
+        rid = rred.id.at<uint16_t>(rpeak.ptmax.y, rpeak.ptmax.x);
+        return (rid != 0xFFFF);
+    }
+
+
+    void create_ghough_library(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        BGHMatcher::T_ghough_library& rlib)
+    {
+        // template id must fit in a posting
+        const size_t ct = rvtables.size();
+        CV_Assert(ct < 0xFFFF);
+        rlib.ct = ct;
+        rlib.start.assign(257, 0);
+        rlib.postings.clear();
+        rlib.total_votes.assign(ct, 0);
+        rlib.code_votes.assign(256 * ct, 0);
+        rlib.code_vmax.assign(256 * ct, 0);
+
+        // code is outer loop and template is inner loop
+        // so postings end up sorted by (code, template id)
+        for (size_t key = 0; key < 256; key++)
+        {
+            rlib.start[key] = rlib.postings.size();
+            for (size_t id = 0; id < ct; id++)
+            {
+                const T_ghough_table& rtable = *rvtables[id];
+                if (key >= rtable.elem_ct)
+                {
+                    continue;
+                }
+
+                const T_ghough_elem& relem = rtable.elems[key];
+                for (size_t k = 0; k < relem.ct; k++)
+                {
+                    const T_pt_votes& rpv = relem.pt_votes[k];
+                    T_ghough_posting posting = { rpv.pt, rpv.votes, static_cast<uint16_t>(id) };
+                    rlib.postings.push_back(posting);
+                    rlib.code_votes[id * 256 + key] += rpv.votes;
+                    rlib.code_vmax[id * 256 + key] = std::max(rlib.code_vmax[id * 256 + key], rpv.votes);
+                }
+                rlib.total_votes[id] += rlib.code_votes[id * 256 + key];
+            }
+        }
+        rlib.start[256] = rlib.postings.size();
+    }
+
+
+    void prune_ghough_library(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_library& rlib,
+        const double thr,
+        std::vector<size_t>& rids)
+    {
+        // count codes of the pixels that are allowed to vote
+        std::vector<uint32_t> hist(256, 0);
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = 1; j < (rimg.cols - 1); j++)
+            {
+                hist[pix[j]]++;
+            }
+        }
+
+        // at one location each entry can get its votes at most once
+        // and each image pixel can give at most the max votes of one entry
+        rids.clear();
+        for (size_t id = 0; id < rlib.ct; id++)
+        {
+            double bound = 0.0;
+            for (size_t key = 1; key < 256; key++)
+            {
+                const double q = static_cast<double>(hist[key]) * rlib.code_vmax[id * 256 + key];
+                bound += std::min<double>(rlib.code_votes[id * 256 + key], q);
+            }
+            if (bound >= thr * rlib.total_votes[id])
+            {
+                rids.push_back(id);
+            }
+        }
+    }
+
+
+    void apply_ghough_library(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_library& rlib,
+        const std::vector<size_t>& rids,
+        std::vector<BGHMatcher::T_ghough_peak>& rpeaks)
+    {
+        rpeaks.assign(rids.size(), T_ghough_peak());
+        if (rids.empty())
+        {
+            return;
+        }
+
+        // one match image per template in a batch
+        // batch size comes from a memory budget so a big image or a big library that is not pruned much
+        // can't use too much memory, and match images are allocated once and cleared for each batch
+        const size_t map_bytes = static_cast<size_t>(rimg.total()) * sizeof(float);
+        const size_t budget_ct = LIBRARY_BATCH_BYTES / std::max<size_t>(1, map_bytes);
+        const size_t batch_ct = std::min(rids.size(), std::max<size_t>(1, budget_ct));
+        const int cols = rimg.cols;
+        std::vector<int> vslot(rlib.ct, -1);
+        std::vector<cv::Mat> vmatch(batch_ct);
+        std::vector<float *> vbase(batch_ct);
+        for (size_t n = 0; n < batch_ct; n++)
+        {
+            vmatch[n].create(rimg.size(), CV_32F);
+            vbase[n] = vmatch[n].ptr<float>(0);
+        }
+
+        for (size_t n0 = 0; n0 < rids.size(); n0 += batch_ct)
+        {
+            const size_t n1 = std::min(rids.size(), n0 + batch_ct);
+
+            // map template id to its place in the batch (or -1 if not in batch)
+            std::fill(vslot.begin(), vslot.end(), -1);
+            for (size_t n = n0; n < n1; n++)
+            {
+                vslot[rids[n]] = static_cast<int>(n - n0);
+            }
+
+            // postings of templates in batch only, with the id replaced by the batch slot
+            // this costs one pass over the index instead of one per pixel
+            std::vector<T_ghough_posting> vpost;
+            std::vector<size_t> vstart(257, 0);
+            for (size_t key = 0; key < 256; key++)
+            {
+                vstart[key] = vpost.size();
+                for (size_t k = rlib.start[key]; k < rlib.start[key + 1]; k++)
+                {
+                    const int slot = vslot[rlib.postings[k].id];
+                    if (slot >= 0)
+                    {
+                        T_ghough_posting posting = rlib.postings[k];
+                        posting.id = static_cast<uint16_t>(slot);
+                        vpost.push_back(posting);
+                    }
+                }
+            }
+            vstart[256] = vpost.size();
+
+            for (size_t n = 0; n < (n1 - n0); n++)
+            {
+                vmatch[n].setTo(0);
+            }
+
+            for (int i = 1; i < (rimg.rows - 1); i++)
+            {
+                const uint8_t * pix = rimg.ptr<uint8_t>(i);
+                for (int j = 1; j < (cols - 1); j++)
+                {
+                    // postings of all templates in batch for the pixel code
+                    const size_t key = pix[j];
+                    const size_t k1 = vstart[key + 1];
+                    for (size_t k = vstart[key]; k < k1; k++)
+                    {
+                        // only vote if pixel is within output image bounds
+                        const T_ghough_posting& rpost = vpost[k];
+                        int mx = (j + rpost.pt.x);
+                        int my = (i + rpost.pt.y);
+                        if ((mx >= 0) && (mx < cols) &&
+                            (my >= 0) && (my < rimg.rows))
+                        {
+                            vbase[rpost.id][my * cols + mx] += rpost.votes;
+                        }
+                    }
+                }
+            }
+
+            for (size_t n = n0; n < n1; n++)
+            {
+                const size_t id = rids[n];
+                T_ghough_peak& rpeak = rpeaks[n];
+                find_ghough_max(vmatch[n - n0], rpeak.qmax, rpeak.ptmax);
+                rpeak.score = (rlib.total_votes[id]) ? (rpeak.qmax / rlib.total_votes[id]) : 0.0;
+            }
+        }
+    }
+
+
+    cv::Rect get_ghough_mask_roi(
+        const cv::Mat& rmask,
+        const int margin)
+    {
+        const cv::Rect rect_img = { 0, 0, rmask.cols, rmask.rows };
+        if (rmask.empty() || (cv::countNonZero(rmask) == 0))
+        {
+            return rect_img;
+        }
 
-        // apply mask to eliminate pixels
-        rmgo &= temp_mask;
+        cv::Rect roi = cv::boundingRect(rmask);
+        roi = cv::Rect(roi.x - margin, roi.y - margin, roi.width + 2 * margin, roi.height + 2 * margin);
+        return roi & rect_img;
     }
 
 
     void init_ghough_table_from_img(
         cv::Mat& rimg,
+        const cv::Mat& rmask,
         BGHMatcher::T_ghough_table& rtable,
-        const BGHMatcher::T_ghough_params& rparams)
+        const BGHMatcher::T_ghough_params& rparams,
+        cv::Mat& rgrad)
     {
-        cv::Mat img_cgrad;
-        create_masked_gradient_orientation_img(rimg, img_cgrad, rparams);
+        // template always uses all of its edge pixels
+        T_ghough_params template_params = rparams;
+        template_params.max_vote_pix = 0;
+        create_masked_gradient_orientation_img(rimg, rgrad, template_params);
 
-        cv::Mat img_target;
-        GaussianBlur(rimg, img_target, { rparams.kblur, rparams.kblur }, 0);
+        // remove gradients of background pixels
+        // the outline has gradients up to half a Sobel kernel outside the mask
+        if (!rmask.empty())
+        {
+            const int r = std::max(1, std::abs(rparams.ksobel) / 2);
+            cv::Mat img_fg;
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, { 2 * r + 1, 2 * r + 1 });
+            cv::dilate(rmask, img_fg, kernel);
+            rgrad.setTo(0, img_fg == 0);
+        }
 
         // create Generalized Hough lookup table from masked gradient image
-        BGHMatcher::create_ghough_table(img_cgrad, rparams.scale, rtable);
+        BGHMatcher::create_ghough_table(rgrad, rparams.scale, rtable);
+        rtable.params = rparams;
+        analyze_ghough_symmetry(rtable, SYMMETRY_THR, rtable.sym);
+    }
+
+
+    void init_ghough_table_from_img(
+        cv::Mat& rimg,
+        BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_params& rparams)
+    {
+        cv::Mat img_cgrad;
+        init_ghough_table_from_img(rimg, rtable, rparams, img_cgrad);
 
 #if 1
         cv::Mat img_display;
         normalize(img_cgrad, img_display, 0, 255, cv::NORM_MINMAX);
         imshow("GHTemplate", img_display);
 #endif
+    }
 
-        // save metadata for lookup table
-        rtable.params = rparams;
+
+    void init_ghough_table_from_img(
+        cv::Mat& rimg,
+        BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_params& rparams,
+        cv::Mat& rgrad)
+    {
+        init_ghough_table_from_img(rimg, cv::Mat(), rtable, rparams, rgrad);
     }
 
 }
@@ -23,6 +23,10 @@
 #ifndef BGH_MATCHER_H_
 #define BGH_MATCHER_H_
 
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <vector>
 #include "opencv2/imgproc.hpp"
 
 
@@ -30,6 +34,10 @@ namespace BGHMatcher
 {
     constexpr double ANG_STEP_MAX = 254.0;
     constexpr double ANG_STEP_MIN = 4.0;
+    constexpr double SYMMETRY_THR = 0.9;
+    constexpr size_t SPARSE_VOTE_RATIO = 16;
+    constexpr size_t EDIT_MERGE_RATIO = 8;
+    constexpr size_t LIBRARY_BATCH_BYTES = 64 * 1024 * 1024;
 
 
     // parameters used to create Generalized Hough lookup table
@@ -40,10 +48,12 @@ namespace BGHMatcher
         double scale;
         double mag_thr;
         double ang_step;
+        int nms_tol;
+        int max_vote_pix;
         _T_ghough_params_struct() :
-            kblur(7), ksobel(7), scale(1.0), mag_thr(1.0), ang_step(8.0) {}
+            kblur(7), ksobel(7), scale(1.0), mag_thr(1.0), ang_step(8.0), nms_tol(-1), max_vote_pix(0) {}
         _T_ghough_params_struct(const int kb, const int ks, const double s, const double m, const double a) :
-            kblur(kb), ksobel(ks), scale(s), mag_thr(m), ang_step(a) {}
+            kblur(kb), ksobel(ks), scale(s), mag_thr(m), ang_step(a), nms_tol(-1), max_vote_pix(0) {}
     } T_ghough_params;
 
 
@@ -58,28 +68,59 @@ namespace BGHMatcher
 
 
     // one gradient orientation element for the Generalized Hough lookup table
+    // entries are sorted by X then by Y and there is room for cap entries
+    // except for the last tail_ct entries which were added by edits and are only sorted among themselves
+    // dead_ct entries were emptied by edits and have no votes until they are squeezed out
     typedef struct _T_ghough_elem_struct
     {
         size_t ct;
+        size_t cap;
+        size_t tail_ct;
+        size_t dead_ct;
         T_pt_votes * pt_votes;
-        _T_ghough_elem_struct() : ct(0), pt_votes(nullptr) {}
+        _T_ghough_elem_struct() : ct(0), cap(0), tail_ct(0), dead_ct(0), pt_votes(nullptr) {}
         ~_T_ghough_elem_struct() { clear(); }
-        void clear() { ct = 0;  if (pt_votes) { delete[] pt_votes; } pt_votes = nullptr; }
+        void clear()
+        {
+            ct = 0; cap = 0; tail_ct = 0; dead_ct = 0;
+            if (pt_votes) { delete[] pt_votes; } pt_votes = nullptr;
+        }
     } T_ghough_elem;
 
     
+    // rotational symmetry of a Generalized Hough lookup table
+    // a table with order N is unchanged by rotations that are multiples of (2pi / N)
+    // rotations are limited to multiples of the gradient code step
+    typedef struct _T_ghough_symmetry_struct
+    {
+        int order;
+        int code_shift;
+        double angle;
+        double score;
+        _T_ghough_symmetry_struct() :
+            order(1), code_shift(0), angle(CV_2PI), score(1.0) {}
+    } T_ghough_symmetry;
+
+
     // Non-STL data structure for Generalized Hough lookup table
+    // a view table does not own its entries (they are in memory owned by something else)
+    // so clearing it only frees the element array
     typedef struct _T_ghough_table_struct
     {
         T_ghough_params params;
+        T_ghough_symmetry sym;
         cv::Size img_sz;
         size_t elem_ct;
         size_t total_votes;
         size_t total_entries;
+        int bin;
+        bool is_compressed;
+        bool is_view;
         T_ghough_elem * elems;
 
         _T_ghough_table_struct() :
-            params(), img_sz(0, 0), elem_ct(0), total_votes(0), total_entries(0), elems(nullptr) {}
+            params(), sym(), img_sz(0, 0), elem_ct(0), total_votes(0), total_entries(0),
+            bin(1), is_compressed(false), is_view(false), elems(nullptr) {}
 
         ~_T_ghough_table_struct() { clear(); }
 
@@ -87,34 +128,511 @@ namespace BGHMatcher
         {
             if (elems != nullptr)
             {
-                for (size_t i = 0; i < elem_ct; i++) { elems[i].clear(); }
+                for (size_t i = 0; i < elem_ct; i++)
+                {
+                    if (is_view) { elems[i].pt_votes = nullptr; }
+                    elems[i].clear();
+                }
                 delete[] elems;
             }
+            sym = {};
             img_sz = { 0, 0 };
             total_votes = 0;
             total_entries = 0;
+            bin = 1;
+            is_compressed = false;
+            is_view = false;
             elems = nullptr;
             elem_ct = 0;
         }
     } T_ghough_table;
 
 
+    // Low-rank separable approximation of a Generalized Hough lookup table.
+    // Each code's entries are treated as a dense 2D vote kernel that is approximated
+    // by a sum of rank-1 (row filter times column filter) terms.
+    // Kernels are stored flipped so they can be applied directly as correlation filters.
+    typedef struct _T_ghough_lowrank_struct
+    {
+        T_ghough_params params;
+        cv::Size img_sz;
+        cv::Size ksize;
+        cv::Point anchor;
+        size_t total_votes;
+        size_t total_terms;
+        double score_err;
+        std::vector<cv::Mat> kx;
+        std::vector<cv::Mat> ky;
+        std::vector<int> ranks;
+        std::vector<double> errs;
+        _T_ghough_lowrank_struct() :
+            params(), img_sz(0, 0), ksize(0, 0), anchor(0, 0),
+            total_votes(0), total_terms(0), score_err(0.0) {}
+    } T_ghough_lowrank;
+
+
+    // Finds bounding box of all offsets in a Generalized Hough lookup table.
+    cv::Rect get_ghough_table_extent(
+        const BGHMatcher::T_ghough_table& rtable);
+
+
+    // Creates masks for a cascade stage that runs before voting.
+    // An integral image of each code counts the codes in the window of pixels that can vote
+    // for a location.  The intersection of that count with the template code histogram
+    // (weighted by the max votes per entry) bounds the votes the location can get.
+    // Candidate mask has locations whose bound is at least a fraction of the total votes.
+    // Vote mask has the pixels that can vote for at least one candidate location.
+    void create_ghough_cascade_masks(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const double thr,
+        cv::Mat& rcand_mask,
+        cv::Mat& rvote_mask);
+
+
+    // open-addressing hash map accumulator for very sparse voting
+    // keys are output pixel indexes (row * cols + col) and capacity is a power of 2
+    typedef struct _T_ghough_sparse_acc_struct
+    {
+        cv::Size img_sz;
+        size_t ct;
+        std::vector<uint32_t> keys;
+        std::vector<uint32_t> votes;
+        _T_ghough_sparse_acc_struct() : img_sz(0, 0), ct(0) {}
+    } T_ghough_sparse_acc;
+
+
+    // Counts the votes that an encoded gradient image (CV_8U) will generate
+    // with a Generalized Hough lookup table.  Border pixels are not counted.
+    size_t count_ghough_votes(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable);
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // using a sparse accumulator.  Only output pixels that get votes use memory.
+    // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    void apply_ghough_transform_sparse(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_sparse_acc& racc);
+
+
+    // Finds maximum in a sparse accumulator.
+    // Ties are broken the same way as cv::minMaxLoc (first in raster order).
+    void find_sparse_acc_peak(
+        const BGHMatcher::T_ghough_sparse_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax);
+
+
+    // Converts a sparse accumulator to a dense CV_32F image.
+    void convert_sparse_acc(
+        const BGHMatcher::T_ghough_sparse_acc& racc,
+        cv::Mat& rout);
+
+
+    // Finds best match in an encoded gradient image (CV_8U).
+    // The number of votes is counted first.  A sparse accumulator is used if there are
+    // few votes compared to the image size.  Otherwise a dense accumulator is used.
+    // Returns true if the sparse accumulator was used.
+    bool find_ghough_match(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_sparse_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax);
+
+
+    // reusable vote accumulator that is cleared lazily one tile at a time
+    // each tile has an epoch tag and every new voting pass starts a new epoch
+    // a tile is zeroed when it gets its first vote in the current epoch
+    // and tiles that are not touched in the current epoch read as zero
+    typedef struct _T_ghough_lazy_acc_struct
+    {
+        int tile_shift;
+        int tiles_x;
+        int tiles_y;
+        uint32_t epoch;
+        std::vector<uint32_t> tile_epoch;
+        cv::Mat data;
+        _T_ghough_lazy_acc_struct() :
+            tile_shift(5), tiles_x(0), tiles_y(0), epoch(0) {}
+    } T_ghough_lazy_acc;
+
+
+    // Starts a new epoch for a lazy accumulator.
+    // Accumulator is reallocated (and all tiles are reset) only if size, type,
+    // or number of tiles (from the tile shift) changes.
+    void begin_lazy_acc(
+        BGHMatcher::T_ghough_lazy_acc& racc,
+        const cv::Size& rsz,
+        const int type);
+
+
+    // Zeroes one tile of a lazy accumulator and tags it with the current epoch.
+    void clear_lazy_acc_tile(
+        BGHMatcher::T_ghough_lazy_acc& racc,
+        const int tile);
+
+
+    // Finds maximum in a lazy accumulator.  Only tiles from the current epoch are checked.
+    // Ties are broken the same way as cv::minMaxLoc (first in raster order).
+    void find_lazy_acc_peak(
+        const BGHMatcher::T_ghough_lazy_acc& racc,
+        double& rqmax,
+        cv::Point& rptmax);
+
+
+    // Converts a lazy accumulator to a normal image where untouched tiles are zero.
+    void convert_lazy_acc(
+        const BGHMatcher::T_ghough_lazy_acc& racc,
+        cv::Mat& rout);
+
+
+    // vote accumulator stored as square tiles instead of image rows
+    // each row of the data matrix holds one tile with its pixels in row-major order
+    // so votes from one pixel that span several rows tend to stay in one small block
+    typedef struct _T_ghough_tiled_acc_struct
+    {
+        int tile_shift;
+        int tiles_x;
+        int tiles_y;
+        cv::Size img_sz;
+        cv::Mat data;
+        _T_ghough_tiled_acc_struct() :
+            tile_shift(3), tiles_x(0), tiles_y(0), img_sz(0, 0) {}
+    } T_ghough_tiled_acc;
+
+
+    // Sets up a zeroed tiled accumulator for an image size.
+    // Tile size is 2^tile_shift, so use 3 for 8x8 tiles or 4 for 16x16 tiles.
+    void init_tiled_acc(
+        BGHMatcher::T_ghough_tiled_acc& racc,
+        const cv::Size& rsz,
+        const int type);
+
+
+    // Converts a tiled accumulator to a normal row-major image.
+    void convert_tiled_acc(
+        const BGHMatcher::T_ghough_tiled_acc& racc,
+        cv::Mat& rout);
+
+
+    // one object hypothesis from a pose search
+    typedef struct _T_ghough_pose_struct
+    {
+        double scale;
+        double angle;
+        double qmax;
+        double score;
+        cv::Point pt;
+        _T_ghough_pose_struct() : scale(1.0), angle(0.0), qmax(0.0), score(0.0), pt(0, 0) {}
+    } T_ghough_pose;
+
+
+    // settings for a coarse-to-fine pose search
+    // coarse scales are evenly spaced in log scale from min to max
+    // each refinement level halves the scale and angle steps around the top hypotheses
+    // radius is the half-size of the region where refined hypotheses vote
+    // refine_cap is the most refinement tables a grid keeps between searches
+    typedef struct _T_ghough_pose_search_struct
+    {
+        double scale_min;
+        double scale_max;
+        int scale_ct;
+        double angle_step;
+        int top_ct;
+        int levels;
+        int radius;
+        size_t refine_cap;
+        _T_ghough_pose_search_struct() :
+            scale_min(0.7), scale_max(1.4), scale_ct(3), angle_step(CV_2PI / 12.0),
+            top_ct(3), levels(2), radius(8), refine_cap(256) {}
+    } T_ghough_pose_search;
+
+
+    // coarse grid of scaled and rotated tables and the pose of each one
+    // refinement tables are built the first time a search needs them and kept for later searches
+    // they are keyed by log scale and angle rounded to 1e-6 and the cache is emptied
+    // at the start of a search once it has more than refine_cap tables
+    // searching changes the cache so a grid must not be searched by more than one thread at a time
+    // tables are not copied so a grid must not be copied either
+    typedef struct _T_ghough_pose_grid_struct
+    {
+        T_ghough_pose_search search;
+        std::vector<T_ghough_pose> poses;
+        std::vector<T_ghough_table> tables;
+        mutable std::map<std::pair<long long, long long>, T_ghough_table> refine_tables;
+    } T_ghough_pose_grid;
+
+
+    // table offsets scaled at run time and stored contiguously
+    // entries for code c are in the range [start[c], start[c+1])
+    typedef struct _T_ghough_scaled_offsets_struct
+    {
+        double scale;
+        std::vector<size_t> start;
+        std::vector<T_pt_votes> pt_votes;
+        _T_ghough_scaled_offsets_struct() : scale(1.0) {}
+    } T_ghough_scaled_offsets;
+
+
+    // Scales every offset of a table with 16.16 fixed-point math.
+    // Scaled offsets are truncated toward zero the same way create_ghough_table does it
+    // so a base table made with scale 1.0 gives (almost always) the same offsets as a table
+    // made with the run-time scale.  They can differ by a pixel when a product lands within
+    // 2^-16 of an integer.  Offsets that become identical are not merged.
+    void get_scaled_ghough_offsets(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double scale,
+        BGHMatcher::T_ghough_scaled_offsets& roffsets);
+
+
+    // peak found by one search (one table or one template)
+    // score is the peak normalized by the total votes of the table
+    typedef struct _T_ghough_peak_struct
+    {
+        double qmax;
+        double score;
+        cv::Point ptmax;
+        _T_ghough_peak_struct() : qmax(0.0), score(0.0), ptmax(0, 0) {}
+    } T_ghough_peak;
+
+
+    // one table entry of one template in a library index
+    typedef struct _T_ghough_posting_struct
+    {
+        cv::Point pt;
+        uint16_t votes;
+        uint16_t id;
+    } T_ghough_posting;
+
+
+    // inverted index over a library of templates keyed by orientation code
+    // postings are stored contiguously and sorted by (code, template id)
+    // postings for code c (all templates) are in [start[c], start[c + 1])
+    // per-template code histograms (sum and max of entry votes) are kept for pruning
+    typedef struct _T_ghough_library_struct
+    {
+        size_t ct;
+        std::vector<size_t> start;
+        std::vector<T_ghough_posting> postings;
+        std::vector<uint32_t> total_votes;
+        std::vector<uint32_t> code_votes;
+        std::vector<uint16_t> code_vmax;
+        _T_ghough_library_struct() : ct(0) {}
+    } T_ghough_library;
+
+
+    // running maximum over many hypotheses (tables)
+    // best has the best normalized score (votes / total votes) at each pixel (CV_32F)
+    // id has the index of the hypothesis with that score (CV_16U, 0xFFFF if none yet)
+    typedef struct _T_ghough_reduction_struct
+    {
+        cv::Mat best;
+        cv::Mat id;
+    } T_ghough_reduction;
+
+
+    // Sets up a reduction for an image size with no hypotheses folded in yet.
+    void init_ghough_reduction(
+        const cv::Size& rsz,
+        BGHMatcher::T_ghough_reduction& rred);
+
+
+    // Folds final votes of one hypothesis for a region into a reduction.
+    // Votes (CV_32F) are normalized by the total votes and pixels where the score is better
+    // than the best so far take the score and the hypothesis id.  Ties keep the older id.
+    void fold_ghough_reduction(
+        const cv::Mat& rvotes,
+        const cv::Rect& rroi,
+        const size_t total_votes,
+        const uint16_t id,
+        BGHMatcher::T_ghough_reduction& rred);
+
+
+    // Votes with many tables and reduces them to best score and best hypothesis id maps.
+    // Each table votes one band of output rows at a time and each band is folded in as
+    // soon as it is done, so memory does not depend on the number of tables.
+    // Bands are never shorter than the table extent height so rows are not rescanned too often.
+    // Id of each table is its index in the list so there must be fewer than 65535 tables.
+    void reduce_ghough_hypotheses(
+        const cv::Mat& rimg,
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        const int band_rows,
+        BGHMatcher::T_ghough_reduction& rred);
+
+
+    // Finds best score in a reduction and the hypothesis id at that location.
+    // Only the score of the peak is filled in since raw vote counts are not kept.
+    // Returns false if no hypothesis was folded in.
+    bool find_ghough_reduction_peak(
+        const BGHMatcher::T_ghough_reduction& rred,
+        BGHMatcher::T_ghough_peak& rpeak,
+        uint16_t& rid);
+
+
+    // one change to a Generalized Hough lookup table entry
+    typedef struct _T_ghough_delta_struct
+    {
+        uint8_t code;
+        cv::Point pt;
+        uint16_t votes;
+    } T_ghough_delta;
+
+
+    // pixel subsampling patterns for voting
+    enum
+    {
+        SAMPLE_ALL = 0,
+        SAMPLE_GRID,
+        SAMPLE_CHECKER,
+    };
+
+
+    // pixel subsampling pattern for voting
+    // GRID: every s-th pixel in X and Y votes, phase selects 1 of s*s offsets
+    // CHECKER: every s-th pixel along diagonals votes, phase selects 1 of s offsets
+    typedef struct _T_ghough_sampling_struct
+    {
+        int mode;
+        int stride;
+        int phase;
+        _T_ghough_sampling_struct() :
+            mode(SAMPLE_ALL), stride(1), phase(0) {}
+        _T_ghough_sampling_struct(const int m, const int s, const int p = 0) :
+            mode(m), stride((s < 1) ? 1 : s), phase(p) {}
+    } T_ghough_sampling;
+
+
+    // state for interleaved voting over a sequence of video frames
+    // each frame votes with one phase of the sampling pattern and the votes
+    // are blended into an exponentially decaying accumulator
+    typedef struct _T_ghough_temporal_struct
+    {
+        T_ghough_sampling samp;
+        double decay;
+        double change_thr;
+        size_t frame_ct;
+        bool is_full_vote;
+        cv::Mat acc;
+        cv::Mat prev_codes;
+        _T_ghough_temporal_struct() :
+            samp(SAMPLE_GRID, 2), decay(0.25), change_thr(0.3), frame_ct(0), is_full_vote(false) {}
+        void clear() { frame_ct = 0; is_full_vote = false; acc.release(); prev_codes.release(); }
+    } T_ghough_temporal;
+
+
+    // state for tracking a match between full searches
+    // full search runs every Nth frame and in between only a small window
+    // around the last match location is voted
+    // the region of the last output is the whole image after a full search
+    typedef struct _T_ghough_tracker_struct
+    {
+        int full_period;
+        int radius;
+        double conf_thr;
+        int frame_ct;
+        bool is_locked;
+        bool is_full_search;
+        double score_ref;
+        cv::Point pt;
+        cv::Rect roi;
+        _T_ghough_tracker_struct() :
+            full_period(5), radius(16), conf_thr(0.7), frame_ct(0),
+            is_locked(false), is_full_search(false), score_ref(0.0), pt(0, 0), roi() {}
+        void clear() { frame_ct = 0; is_locked = false; is_full_search = false; score_ref = 0.0; }
+    } T_ghough_tracker;
+
+
+    // Adds a weighted vote to an accumulator pixel.
+    // 16-bit accumulators saturate since subsampled votes are multiplied by the sampling
+    // factor and a strong template can overflow 16 bits.  Float accumulators never overflow.
+    template<typename T>
+    inline void add_weighted_vote(T& racc, const uint16_t votes, const uint16_t wt)
+    {
+        racc += static_cast<T>(votes * wt);
+    }
+
+
+    inline void add_weighted_vote(uint16_t& racc, const uint16_t votes, const uint16_t wt)
+    {
+        const uint32_t sum = static_cast<uint32_t>(racc) + static_cast<uint32_t>(votes) * wt;
+        racc = static_cast<uint16_t>((sum > 0xFFFFu) ? 0xFFFFu : sum);
+    }
+
+
+    // Returns the number of pixels represented by each voting pixel in a sampling pattern.
+    inline int get_sampling_factor(const BGHMatcher::T_ghough_sampling& rsamp)
+    {
+        const int s = rsamp.stride;
+        return (rsamp.mode == SAMPLE_GRID) ? (s * s) : ((rsamp.mode == SAMPLE_CHECKER) ? s : 1);
+    }
+
+
+    // Determines the first voting column (at or after j0) and column step for one row.
+    // Returns false if no pixels in the row are part of the sampling pattern.
+    inline bool get_sampling_cols(
+        const BGHMatcher::T_ghough_sampling& rsamp,
+        const int i,
+        const int j0,
+        int& rjstart,
+        int& rjstep)
+    {
+        const int s = rsamp.stride;
+        int jphase = 0;
+        rjstart = j0;
+        rjstep = 1;
+        if (rsamp.mode == SAMPLE_GRID)
+        {
+            if ((i % s) != ((rsamp.phase / s) % s))
+            {
+                return false;
+            }
+            jphase = rsamp.phase % s;
+        }
+        else if (rsamp.mode == SAMPLE_CHECKER)
+        {
+            jphase = (s - ((i + rsamp.phase) % s)) % s;
+        }
+        else
+        {
+            return true;
+        }
+        rjstart = j0 + ((jphase - (j0 % s)) + s) % s;
+        rjstep = s;
+        return true;
+    }
+
+
     // Applies Generalized Hough transform to an encoded gradient image (CV_8U).
     // The size of the target image used to generate the table will constrain the results.
     // Pixels near border and within half the X or Y dimensions of target image will be 0.
+    // Optional sampling pattern restricts voting to a subset of pixels.  Their votes are
+    // reweighted by the sampling factor so scores remain comparable to full voting.
     // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // A CV_16U output saturates at 65535 so use CV_32F when subsampling a strong template.
     // Output image is same size as input.  Maxima indicate good matches.
     template<int E, typename T>
     void apply_ghough_transform(
         const cv::Mat& rimg,
         cv::Mat& rout,
-        const BGHMatcher::T_ghough_table& rtable)
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_sampling& rsamp = T_ghough_sampling())
     {
+        int jstart;
+        int jstep;
+        const uint16_t wt = static_cast<uint16_t>(get_sampling_factor(rsamp));
         rout = cv::Mat::zeros(rimg.size(), E);
         for (int i = rtable.img_sz.height / 2; i < rimg.rows - rtable.img_sz.height / 2; i++)
         {
+            if (!get_sampling_cols(rsamp, i, rtable.img_sz.width / 2, jstart, jstep))
+            {
+                continue;
+            }
             const uint8_t * pix = rimg.ptr<uint8_t>(i);
-            for (int j = rtable.img_sz.width / 2; j < rimg.cols - rtable.img_sz.width / 2; j++)
+            for (int j = jstart; j < rimg.cols - rtable.img_sz.width / 2; j += jstep)
             {
                 // look up voting table for pixel
                 // iterate through the points (if any) and add votes
@@ -127,7 +645,7 @@ namespace BGHMatcher
                     int mx = (j + rp.x);
                     int my = (i + rp.y);
                     T * pix = rout.ptr<T>(my) + mx;
-                    *pix += pt_votes[k].votes;
+                    add_weighted_vote(*pix, pt_votes[k].votes, wt);
                 }
             }
         }
@@ -136,20 +654,505 @@ namespace BGHMatcher
 
     // Applies Generalized Hough transform to an input encoded gradient image (CV_8U).
     // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    // Optional sampling pattern restricts voting to a subset of pixels (see above).
     // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
     // Output image is same size as input.  Maxima indicate good matches.
     template<int E, typename T>
     void apply_ghough_transform_allpix(
         const cv::Mat& rimg,
         cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_sampling& rsamp = T_ghough_sampling())
+    {
+        int jstart;
+        int jstep;
+        const uint16_t wt = static_cast<uint16_t>(get_sampling_factor(rsamp));
+        rout = cv::Mat::zeros(rimg.size(), E);
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            if (!get_sampling_cols(rsamp, i, 1, jstart, jstep))
+            {
+                continue;
+            }
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = jstart; j < (rimg.cols - 1); j += jstep)
+            {
+                // look up voting table for pixel
+                // iterate through the points and add votes
+                uint8_t uu = pix[j];
+                T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                const size_t ct = rtable.elems[uu].ct;
+                for (size_t k = 0; k < ct; k++)
+                {
+                    // only vote if pixel is within output image bounds
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (j + rp.x);
+                    int my = (i + rp.y);
+                    if ((mx >= 0) && (mx < rout.cols) &&
+                        (my >= 0) && (my < rout.rows))
+                    {
+                        T * pix = rout.ptr<T>(my) + mx;
+                        add_weighted_vote(*pix, pt_votes[k].votes, wt);
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Returns true if parameters have an angle step of exactly 8, 16, 32, or 64
+    // so a specialized (compile-time) kernel can be used for them.
+    inline bool is_ghough_params_coded(const BGHMatcher::T_ghough_params& rparams)
+    {
+        const double a = rparams.ang_step;
+        return (a == 8.0) || (a == 16.0) || (a == 32.0) || (a == 64.0);
+    }
+
+
+    // Adds the votes of one table entry list at a pixel with no range checks.
+    // Caller guarantees every offset lands inside the output image.
+    // Votes are added like apply_ghough_transform_allpix does so 16-bit accumulators saturate.
+    // Loop is unrolled by 4 since entry lists are usually long.
+    template<typename T>
+    inline void vote_ghough_unchecked(
+        cv::Mat& rout,
+        const int i,
+        const int j,
+        const T_pt_votes * pt_votes,
+        const size_t ct)
+    {
+        T * pbase = rout.ptr<T>(i) + j;
+        const int step = static_cast<int>(rout.step1());
+        size_t k = 0;
+        for (; (k + 4) <= ct; k += 4)
+        {
+            add_weighted_vote(pbase[pt_votes[k + 0].pt.y * step + pt_votes[k + 0].pt.x], pt_votes[k + 0].votes, 1);
+            add_weighted_vote(pbase[pt_votes[k + 1].pt.y * step + pt_votes[k + 1].pt.x], pt_votes[k + 1].votes, 1);
+            add_weighted_vote(pbase[pt_votes[k + 2].pt.y * step + pt_votes[k + 2].pt.x], pt_votes[k + 2].votes, 1);
+            add_weighted_vote(pbase[pt_votes[k + 3].pt.y * step + pt_votes[k + 3].pt.x], pt_votes[k + 3].votes, 1);
+        }
+        for (; k < ct; k++)
+        {
+            add_weighted_vote(pbase[pt_votes[k].pt.y * step + pt_votes[k].pt.x], pt_votes[k].votes, 1);
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // with a lookup table whose code count N is fixed at compile time.
+    // The table's entry lists are copied into a fixed-size array of N+1 codes
+    // so codes above N are skipped without reading past the table.
+    // Pixels far enough from the border to keep every vote in bounds use
+    // an unrolled loop with no range checks.  Other pixels are range-checked.
+    // Results are identical to apply_ghough_transform_allpix with full voting.
+    // Template parameters specify output type and code count.
+    template<int E, typename T, int N>
+    void apply_ghough_transform_coded(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable)
+    {
+        static_assert((N > 0) && (N < 255), "code count must fit in 8-bit codes");
+        const T_pt_votes * code_pt_votes[N + 1];
+        size_t code_ct[N + 1];
+        for (int key = 0; key <= N; key++)
+        {
+            const bool is_elem = (static_cast<size_t>(key) < rtable.elem_ct);
+            code_pt_votes[key] = (is_elem) ? rtable.elems[key].pt_votes : nullptr;
+            code_ct[key] = (is_elem) ? rtable.elems[key].ct : 0;
+        }
+
+        // pixel at p votes at p+d so the unchecked region is the image
+        // shrunk by the range of table offsets
+        const cv::Rect ext = get_ghough_table_extent(rtable);
+        const int i0 = std::max(1, -ext.y);
+        const int i1 = std::min(rimg.rows - 1, rimg.rows - (ext.y + ext.height - 1));
+        const int j0 = std::max(1, -ext.x);
+        const int j1 = std::min(rimg.cols - 1, rimg.cols - (ext.x + ext.width - 1));
+
+        rout = cv::Mat::zeros(rimg.size(), E);
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            const bool is_row_inside = (i >= i0) && (i < i1);
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = 1; j < (rimg.cols - 1); j++)
+            {
+                const uint8_t uu = pix[j];
+                if (uu > N)
+                {
+                    continue;
+                }
+                const T_pt_votes * pt_votes = code_pt_votes[uu];
+                const size_t ct = code_ct[uu];
+                if (is_row_inside && (j >= j0) && (j < j1))
+                {
+                    vote_ghough_unchecked<T>(rout, i, j, pt_votes, ct);
+                }
+                else
+                {
+                    for (size_t k = 0; k < ct; k++)
+                    {
+                        const cv::Point& rp = pt_votes[k].pt;
+                        int mx = (j + rp.x);
+                        int my = (i + rp.y);
+                        if ((mx >= 0) && (mx < rout.cols) &&
+                            (my >= 0) && (my < rout.rows))
+                        {
+                            add_weighted_vote(*(rout.ptr<T>(my) + mx), pt_votes[k].votes, 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U).
+    // Picks a specialized kernel if the table's angle step is 8, 16, 32, or 64
+    // and voting is not subsampled.  Otherwise falls back to apply_ghough_transform_allpix.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Output image is same size as input.  Maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_dispatch(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_sampling& rsamp = T_ghough_sampling())
+    {
+        const bool is_coded = is_ghough_params_coded(rtable.params) && (get_sampling_factor(rsamp) == 1);
+        switch ((is_coded) ? static_cast<int>(rtable.params.ang_step) : 0)
+        {
+            case 8: apply_ghough_transform_coded<E, T, 8>(rimg, rout, rtable); break;
+            case 16: apply_ghough_transform_coded<E, T, 16>(rimg, rout, rtable); break;
+            case 32: apply_ghough_transform_coded<E, T, 32>(rimg, rout, rtable); break;
+            case 64: apply_ghough_transform_coded<E, T, 64>(rimg, rout, rtable); break;
+            default: apply_ghough_transform_allpix<E, T>(rimg, rout, rtable, rsamp); break;
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // with the offsets of a base table scaled by a run-time factor.
+    // Scaled offsets are computed once per call so no table is stored for each scale.
+    // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Output image is same size as input.  Maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_scaled(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const double scale)
+    {
+        T_ghough_scaled_offsets offsets;
+        get_scaled_ghough_offsets(rtable, scale, offsets);
+        const size_t * start = offsets.start.data();
+        const T_pt_votes * pt_votes = offsets.pt_votes.data();
+
+        rout = cv::Mat::zeros(rimg.size(), E);
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = 1; j < (rimg.cols - 1); j++)
+            {
+                // look up scaled offsets for pixel
+                // iterate through the points and add votes
+                uint8_t uu = pix[j];
+                for (size_t k = start[uu]; k < start[uu + 1]; k++)
+                {
+                    // only vote if pixel is within output image bounds
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (j + rp.x);
+                    int my = (i + rp.y);
+                    if ((mx >= 0) && (mx < rout.cols) &&
+                        (my >= 0) && (my < rout.rows))
+                    {
+                        T * pix = rout.ptr<T>(my) + mx;
+                        *pix += pt_votes[k].votes;
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U).
+    // The table must be a binned table with offsets pre-quantized by its bin factor.
+    // Pixel (x,y) votes into bin (x/b,y/b) so output is (1/b) the size of input in each dimension.
+    // Votes that would fall outside the output image are discarded.
+    // Optional sampling pattern restricts voting to a subset of pixels (see above).
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    template<int E, typename T>
+    void apply_ghough_transform_binned(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_sampling& rsamp = T_ghough_sampling())
+    {
+        int jstart;
+        int jstep;
+        const uint16_t wt = static_cast<uint16_t>(get_sampling_factor(rsamp));
+        const int b = rtable.bin;
+        rout = cv::Mat::zeros((rimg.rows + b - 1) / b, (rimg.cols + b - 1) / b, E);
+        for (int i = 1; i < (rimg.rows - 1); i++)
+        {
+            if (!get_sampling_cols(rsamp, i, 1, jstart, jstep))
+            {
+                continue;
+            }
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            const int bi = i / b;
+            for (int j = jstart; j < (rimg.cols - 1); j += jstep)
+            {
+                // look up voting table for pixel
+                // iterate through the points and add votes to the bins
+                uint8_t uu = pix[j];
+                T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                const size_t ct = rtable.elems[uu].ct;
+                const int bj = j / b;
+                for (size_t k = 0; k < ct; k++)
+                {
+                    // only vote if bin is within output image bounds
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (bj + rp.x);
+                    int my = (bi + rp.y);
+                    if ((mx >= 0) && (mx < rout.cols) &&
+                        (my >= 0) && (my < rout.rows))
+                    {
+                        T * pix = rout.ptr<T>(my) + mx;
+                        add_weighted_vote(*pix, pt_votes[k].votes, wt);
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // but only accumulates votes that fall within a region of interest.
+    // Only the pixels that can vote into the region are visited.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Output image is same size as region of interest.
+    template<int E, typename T>
+    void apply_ghough_transform_roi(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const cv::Rect& rroi)
+    {
+        rout = cv::Mat::zeros(rroi.size(), E);
+
+        // a pixel at p votes at p+d so pixels that can reach the region
+        // are in the region shifted by the negated range of table offsets
+        const cv::Rect ext = get_ghough_table_extent(rtable);
+        const int i0 = std::max<int>(1, rroi.y - (ext.y + ext.height - 1));
+        const int i1 = std::min<int>(rimg.rows - 1, rroi.y + rroi.height - ext.y);
+        const int j0 = std::max<int>(1, rroi.x - (ext.x + ext.width - 1));
+        const int j1 = std::min<int>(rimg.cols - 1, rroi.x + rroi.width - ext.x);
+        for (int i = i0; i < i1; i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = j0; j < j1; j++)
+            {
+                // look up voting table for pixel
+                // iterate through the points and add votes
+                uint8_t uu = pix[j];
+                T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                const size_t ct = rtable.elems[uu].ct;
+                for (size_t k = 0; k < ct; k++)
+                {
+                    // only vote if pixel is within region of interest
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (j + rp.x) - rroi.x;
+                    int my = (i + rp.y) - rroi.y;
+                    if ((mx >= 0) && (mx < rout.cols) &&
+                        (my >= 0) && (my < rout.rows))
+                    {
+                        T * pix = rout.ptr<T>(my) + mx;
+                        *pix += pt_votes[k].votes;
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Refines a match found with a binned table by re-voting at full resolution.
+    // Full-resolution table is used to vote only into the winning bin and its neighbors
+    // since offset quantization can shift a vote by one bin.
+    // Returns the refined maximum and its location in full-resolution image coordinates.
+    template<int E, typename T>
+    void refine_binned_match(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const cv::Point& rptbin,
+        const int bin,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        cv::Mat img_roi;
+        cv::Rect roi = { (rptbin.x - 1) * bin, (rptbin.y - 1) * bin, 3 * bin, 3 * bin };
+        roi &= cv::Rect(0, 0, rimg.cols, rimg.rows);
+        apply_ghough_transform_roi<E, T>(rimg, img_roi, rtable, roi);
+        cv::minMaxLoc(img_roi, nullptr, &rqmax, nullptr, &rptmax);
+        rptmax += roi.tl();
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // using a reusable accumulator that is only cleared where votes land.
+    // Only votes that fall within a region of interest are accumulated and only the
+    // pixels that can vote into the region are visited.  Tiles outside the region
+    // are never cleared so the cost doesn't depend on the image size.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Accumulator is same size as input (region keeps image coordinates).
+    template<int E, typename T>
+    void apply_ghough_transform_lazy_roi(
+        const cv::Mat& rimg,
+        BGHMatcher::T_ghough_lazy_acc& racc,
+        const BGHMatcher::T_ghough_table& rtable,
+        const cv::Rect& rroi)
+    {
+        begin_lazy_acc(racc, rimg.size(), E);
+        const int sh = racc.tile_shift;
+        const cv::Rect roi = rroi & cv::Rect(0, 0, rimg.cols, rimg.rows);
+
+        // a pixel at p votes at p+d so pixels that can reach the region
+        // are in the region shifted by the negated range of table offsets
+        const cv::Rect ext = get_ghough_table_extent(rtable);
+        const int i0 = std::max<int>(1, roi.y - (ext.y + ext.height - 1));
+        const int i1 = std::min<int>(rimg.rows - 1, roi.y + roi.height - ext.y);
+        const int j0 = std::max<int>(1, roi.x - (ext.x + ext.width - 1));
+        const int j1 = std::min<int>(rimg.cols - 1, roi.x + roi.width - ext.x);
+        for (int i = i0; i < i1; i++)
+        {
+            const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            for (int j = j0; j < j1; j++)
+            {
+                // look up voting table for pixel
+                // iterate through the points and add votes
+                uint8_t uu = pix[j];
+                T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                const size_t ct = rtable.elems[uu].ct;
+                for (size_t k = 0; k < ct; k++)
+                {
+                    // only vote if pixel is within region of interest
+                    const cv::Point& rp = pt_votes[k].pt;
+                    int mx = (j + rp.x);
+                    int my = (i + rp.y);
+                    if ((mx >= roi.x) && (mx < (roi.x + roi.width)) &&
+                        (my >= roi.y) && (my < (roi.y + roi.height)))
+                    {
+                        // clear tile if this is its first vote in this epoch
+                        const int tile = (my >> sh) * racc.tiles_x + (mx >> sh);
+                        if (racc.tile_epoch[tile] != racc.epoch)
+                        {
+                            clear_lazy_acc_tile(racc, tile);
+                        }
+                        T * pix = racc.data.ptr<T>(my) + mx;
+                        *pix += pt_votes[k].votes;
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // using a reusable accumulator that is only cleared where votes land.
+    // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Accumulator is same size as input.  Maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_lazy(
+        const cv::Mat& rimg,
+        BGHMatcher::T_ghough_lazy_acc& racc,
         const BGHMatcher::T_ghough_table& rtable)
+    {
+        apply_ghough_transform_lazy_roi<E, T>(rimg, racc, rtable, cv::Rect(0, 0, rimg.cols, rimg.rows));
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // using an accumulator with a tiled memory layout.
+    // Input pixels are visited tile by tile with the same tile size as the accumulator.
+    // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Use convert_tiled_acc to get a normal image where maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_tiled(
+        const cv::Mat& rimg,
+        BGHMatcher::T_ghough_tiled_acc& racc,
+        const BGHMatcher::T_ghough_table& rtable)
+    {
+        init_tiled_acc(racc, rimg.size(), E);
+        const int sh = racc.tile_shift;
+        const int tile_sz = 1 << sh;
+        const int tile_mask = tile_sz - 1;
+        T * pacc = racc.data.ptr<T>(0);
+        for (int i0 = 0; i0 < rimg.rows; i0 += tile_sz)
+        {
+            const int i1 = std::min(i0 + tile_sz, rimg.rows - 1);
+            for (int j0 = 0; j0 < rimg.cols; j0 += tile_sz)
+            {
+                const int j1 = std::min(j0 + tile_sz, rimg.cols - 1);
+                for (int i = std::max(i0, 1); i < i1; i++)
+                {
+                    const uint8_t * pix = rimg.ptr<uint8_t>(i);
+                    for (int j = std::max(j0, 1); j < j1; j++)
+                    {
+                        // look up voting table for pixel
+                        // iterate through the points and add votes
+                        uint8_t uu = pix[j];
+                        T_pt_votes * pt_votes = rtable.elems[uu].pt_votes;
+                        const size_t ct = rtable.elems[uu].ct;
+                        for (size_t k = 0; k < ct; k++)
+                        {
+                            // only vote if pixel is within output image bounds
+                            const cv::Point& rp = pt_votes[k].pt;
+                            int mx = (j + rp.x);
+                            int my = (i + rp.y);
+                            if ((mx >= 0) && (mx < racc.img_sz.width) &&
+                                (my >= 0) && (my < racc.img_sz.height))
+                            {
+                                // tile index selects block and low bits select pixel within block
+                                const int tile = (my >> sh) * racc.tiles_x + (mx >> sh);
+                                const int offset = ((my & tile_mask) << sh) + (mx & tile_mask);
+                                pacc[(tile << (2 * sh)) + offset] += pt_votes[k].votes;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // but only pixels that are non-zero in a mask image (CV_8U) are allowed to vote.
+    // Each vote is range-checked.  Votes that would fall outside the image are discarded.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Output image is same size as input.  Maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_masked(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const cv::Mat& rmask)
     {
         rout = cv::Mat::zeros(rimg.size(), E);
         for (int i = 1; i < (rimg.rows - 1); i++)
         {
             const uint8_t * pix = rimg.ptr<uint8_t>(i);
+            const uint8_t * pmask = rmask.ptr<uint8_t>(i);
             for (int j = 1; j < (rimg.cols - 1); j++)
             {
+                // skip pixels that are masked
+                if (!pmask[j])
+                {
+                    continue;
+                }
+
                 // look up voting table for pixel
                 // iterate through the points and add votes
                 uint8_t uu = pix[j];
@@ -173,10 +1176,89 @@ namespace BGHMatcher
     }
 
 
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // after a cascade stage rejects locations that can't reach a fraction of the total votes.
+    // Only pixels that can vote for a surviving location are voted and rejected locations are 0.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    // Output image is same size as input.  Maxima indicate good matches.
+    template<int E, typename T>
+    void apply_ghough_transform_cascade(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        const double thr)
+    {
+        cv::Mat cand_mask;
+        cv::Mat vote_mask;
+        create_ghough_cascade_masks(rimg, rtable, thr, cand_mask, vote_mask);
+        apply_ghough_transform_masked<E, T>(rimg, rout, rtable, vote_mask);
+        rout.setTo(0, cand_mask == 0);
+    }
+
+
+    // Finds best match in an encoded gradient image (CV_8U) with a full search every Nth frame.
+    // Between full searches the match is tracked by voting only within a small window
+    // around its last location.  A full search is triggered early if the tracked score
+    // drops below a fraction of the score from the last full search.
+    // Output image is only the tracking window when a full search was not done
+    // so no full-size accumulator is allocated.  The tracker's region says where it is.
+    // After a full search the output is the same size as the input.
+    // Template parameters specify output type.  Try <CV_32F,float> or <CV_16U,uint16_t>.
+    template<int E, typename T>
+    void track_ghough_match(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_tracker& rtracker,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        rtracker.frame_ct++;
+        rtracker.is_full_search = (!rtracker.is_locked) || (rtracker.frame_ct >= rtracker.full_period);
+
+        if (!rtracker.is_full_search)
+        {
+            // vote only in window around last match
+            cv::Mat img_roi;
+            const int r = rtracker.radius;
+            cv::Rect roi = { rtracker.pt.x - r, rtracker.pt.y - r, 2 * r + 1, 2 * r + 1 };
+            roi &= cv::Rect(0, 0, rimg.cols, rimg.rows);
+            apply_ghough_transform_roi<E, T>(rimg, img_roi, rtable, roi);
+            cv::minMaxLoc(img_roi, nullptr, &rqmax, nullptr, &rptmax);
+            rptmax += roi.tl();
+
+            // keep tracking if score is still good
+            // otherwise fall through to a full search
+            if (rqmax >= (rtracker.conf_thr * rtracker.score_ref))
+            {
+                rout = img_roi;
+                rtracker.pt = rptmax;
+                rtracker.roi = roi;
+                return;
+            }
+            rtracker.is_full_search = true;
+        }
+
+        apply_ghough_transform_allpix<E, T>(rimg, rout, rtable);
+        cv::minMaxLoc(rout, nullptr, &rqmax, nullptr, &rptmax);
+        rtracker.pt = rptmax;
+        rtracker.roi = cv::Rect(0, 0, rimg.cols, rimg.rows);
+        rtracker.score_ref = rqmax;
+        rtracker.is_locked = (rqmax > 0.0);
+        rtracker.frame_ct = 0;
+    }
+
+
     // This is the preprocessing step for the "classic" Generalized Hough algorithm.
     // Calculates Sobel derivatives of input grayscale image.  Converts to polar coordinates and
     // finds magnitude and angle (orientation).  Converts angle to integer with 4 to 254 steps.
+    // Angles of 0 and 2pi both become code 1.
     // Masks the pixels with gradient magnitudes above a threshold.
+    // If the NMS tolerance is non-negative then edges are also thinned by non-maximum suppression.
+    // Only pixels that are local maxima along the gradient direction are kept.  A tolerance
+    // greater than 0 dilates the thinned edges by that many pixels to make them less brittle.
+    // If the max number of voting pixels is non-zero then the magnitude threshold is raised
+    // (if necessary) so at most that many pixels are left in the output image.
     void create_masked_gradient_orientation_img(
         const cv::Mat& rimg,
         cv::Mat& rmgo,
@@ -191,13 +1273,256 @@ namespace BGHMatcher
         BGHMatcher::T_ghough_table& rtable);
 
 
+    // Creates a view table that shares the entries of another table.
+    // Only the element array is allocated.  Source table must stay valid
+    // and unchanged while the view exists.  A view table can't be edited.
+    void create_ghough_table_view(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Creates a binned copy of a Generalized Hough lookup table.
+    // Offsets are divided by the integer bin factor and rounded.  Offsets that become
+    // identical are merged and their votes are combined.  Source table is not modified.
+    void create_binned_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const int bin,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Applies Generalized Hough transform to a sequence of encoded gradient images (CV_8U).
+    // Each call votes with only one phase of the sampling pattern (1/N of the pixels).
+    // Phase advances every call so all pixels vote over N calls.  Reweighted votes are blended
+    // into a persistent accumulator with the decay weight.  A full vote replaces the accumulator
+    // on the first call or when the fraction of changed codes exceeds the change threshold.
+    // Output image is CV_32F and same size as input.  Maxima indicate good matches.
+    void apply_ghough_transform_temporal(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_table& rtable,
+        BGHMatcher::T_ghough_temporal& rstate);
+
+
+    // Creates a low-rank separable approximation of a Generalized Hough lookup table.
+    // Ranks are chosen across all codes so the relative error of the match score at the
+    // template's own location does not exceed the target error.  Terms are added in order
+    // of singular value so the fewest terms are used.  Max rank caps the rank of each code.
+    void create_ghough_lowrank(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double target_err,
+        const int max_rank,
+        BGHMatcher::T_ghough_lowrank& rlowrank);
+
+
+    // Applies Generalized Hough transform to an input encoded gradient image (CV_8U)
+    // using a low-rank approximation of the lookup table.  Voting becomes separable
+    // filtering of one mask per code.  Cost per pixel is proportional to rank * (w + h).
+    // Output image is CV_32F and same size as input.  Maxima indicate good matches.
+    void apply_ghough_transform_lowrank(
+        const cv::Mat& rimg,
+        cv::Mat& rout,
+        const BGHMatcher::T_ghough_lowrank& rlowrank);
+
+
+    // Prints rank and error for each code of a low-rank approximation.
+    void print_ghough_lowrank_report(
+        const BGHMatcher::T_ghough_lowrank& rlowrank,
+        std::ostream& ros);
+
+
+    // Returns number of distinct gradient orientation codes for a set of parameters.
+    // Codes are 1 to N.  Code 0 is reserved for masked pixels.
+    // An angle of 2pi is the same orientation as 0 so it wraps to code 1.
+    int get_ghough_code_ct(
+        const BGHMatcher::T_ghough_params& rparams);
+
+
+    // Creates a copy of a Generalized Hough lookup table that matches a rotated object.
+    // Offsets are rotated by the angle (radians) and codes are shifted by the nearest
+    // number of code steps.  Offsets that become identical are merged.
+    void create_rotated_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const double angle,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Creates a copy of a Generalized Hough lookup table that matches a scaled and rotated object.
+    // Offsets are scaled and rotated by the angle (radians) and codes are shifted like a rotated table.
+    // Scale is multiplied into the table parameters so the box drawn for a match grows with it.
+    void create_posed_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const double scale,
+        const double angle,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Detects rotational symmetry of a Generalized Hough lookup table.
+    // Every rotation that is a whole number of code steps and evenly divides 2pi is tested.
+    // Score is the fraction of votes that still match (within 1 pixel) after rotation.
+    // The smallest rotation with a score above the threshold determines the symmetry.
+    void analyze_ghough_symmetry(
+        const BGHMatcher::T_ghough_table& rtable,
+        const double thr,
+        BGHMatcher::T_ghough_symmetry& rsym);
+
+
+    // Creates a compressed copy of a symmetric Generalized Hough lookup table.
+    // Only the canonical codes (1 to code shift) are kept along with the symmetry.
+    // A table without symmetry is copied as-is.  A compressed table can't be used for voting
+    // so it is meant for storing or sending a table.  Expand it again before voting.
+    void compress_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Expands a compressed Generalized Hough lookup table back into a full table
+    // by rotating the canonical codes through every rotation of the symmetry.
+    void expand_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Adds votes to entries of an existing table.  Entries that don't exist yet are created.
+    // Changes are grouped by code and only codes that change are touched.  Entries are found
+    // with a binary search of the sorted part and of the sorted tail of their element.
+    // Existing ones are updated in place and new ones are merged into the tail once per code
+    // per call.  The tail is only merged into the sorted part (and emptied entries squeezed out)
+    // when its tail or empty entry count passes 1/EDIT_MERGE_RATIO of its entries, so the
+    // cost follows the size of the change instead of the size of the table.
+    // Element arrays grow with slack capacity so repeated inserts rarely reallocate.
+    // Total votes and total entries (with votes) are exact after every call
+    // but symmetry is not analyzed again.
+    // Returns false (and changes nothing) for a view table.
+    bool insert_ghough_entries(
+        BGHMatcher::T_ghough_table& rtable,
+        const std::vector<BGHMatcher::T_ghough_delta>& rdelta);
+
+
+    // Removes votes from entries of an existing table.  An entry with no votes left stays in
+    // place until its element is merged like an insert does.  Voting still walks these empty
+    // entries (they add nothing) so an edited table costs up to 1/EDIT_MERGE_RATIO more per vote
+    // than a freshly built one.
+    // Changes for offsets that are not in the table are ignored.
+    // Returns false (and changes nothing) for a view table.
+    bool remove_ghough_entries(
+        BGHMatcher::T_ghough_table& rtable,
+        const std::vector<BGHMatcher::T_ghough_delta>& rdelta);
+
+
+    // Creates list of rotation angles for a search with a given angle step.
+    // Angles that are equivalent under the table symmetry are skipped.
+    void get_ghough_search_angles(
+        const BGHMatcher::T_ghough_symmetry& rsym,
+        const double angle_step,
+        std::vector<double>& rangles);
+
+
+    // Creates one "tolerant" table that merges the entries of a template in several nearby poses
+    // so one voting pass covers a range of scales and rotations (with less precise peaks).
+    // Votes of offsets that overlap are added.  If cap is more than 0 then no entry can have
+    // more than that many votes.  Box size is big enough for every pose.
+    void create_union_ghough_table(
+        const BGHMatcher::T_ghough_table& rsrc,
+        const std::vector<BGHMatcher::T_ghough_pose>& rposes,
+        const int cap,
+        BGHMatcher::T_ghough_table& rtable);
+
+
+    // Creates the coarse grid of scaled and rotated tables for a pose search.
+    // Angles come from get_ghough_search_angles so symmetric rotations are skipped.
+    // Grid only depends on the template so it can be built once when the template is loaded.
+    void create_ghough_pose_grid(
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_pose_search& rsearch,
+        BGHMatcher::T_ghough_pose_grid& rgrid);
+
+
+    // Searches for an object at unknown position, scale, and rotation.
+    // Every grid table votes over the whole encoded gradient image and the best poses survive.
+    // Then each level halves the scale and angle steps and scores the neighbors of the survivors
+    // by voting only in a small region around them.  Hypotheses are returned best first.
+    // Neighbor tables are cached in the grid (up to a cap) so later searches don't rebuild them.
+    // Grid is changed by the search so it can't be searched by several threads at once.
+    // Output image is the match image of the best coarse pose.
+    void search_ghough_pose(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_pose_grid& rgrid,
+        cv::Mat& rout,
+        std::vector<BGHMatcher::T_ghough_pose>& rposes);
+
+
+    // Creates an inverted index from a library of Generalized Hough tables.
+    // Template id is the index of its table in the list.  Library must have fewer than 65535 tables.
+    void create_ghough_library(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        BGHMatcher::T_ghough_library& rlib);
+
+
+    // First pass of a library search.  Codes in the encoded gradient image are counted
+    // and for each template the votes it could get at any one location are bounded
+    // by the sum over codes of min(template votes, image count * max entry votes).
+    // Templates whose bound is at least a fraction of their total votes survive.
+    void prune_ghough_library(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_library& rlib,
+        const double thr,
+        std::vector<size_t>& rids);
+
+
+    // Second pass of a library search.  Listed templates vote together in one pass over the image
+    // (one pass per batch to limit memory).  A batch has as many templates as full size match images
+    // fit in LIBRARY_BATCH_BYTES (at least 1) and its match images are reused by the next batch.
+    // Each pixel visits the postings of
+    // its code once and every posting votes into the match image of its template.
+    // The peak for each template is returned (in same order as the list).
+    void apply_ghough_library(
+        const cv::Mat& rimg,
+        const BGHMatcher::T_ghough_library& rlib,
+        const std::vector<size_t>& rids,
+        std::vector<BGHMatcher::T_ghough_peak>& rpeaks);
+
+
     // Helper function for initializing Generalized Hough table from grayscale image.
     // Default parameters are good starting point for doing object identification.
     // Table must be a newly created object with blank data.
+    // The max voting pixel limit is not applied to the template but it is saved
+    // in the table parameters so it will be applied to the frames.
+    // Symmetry of the table is also analyzed and saved.
+    // Encoded gradient image of the template is shown in a window.
     void init_ghough_table_from_img(
         cv::Mat& rimg,
         BGHMatcher::T_ghough_table& rtable,
         const BGHMatcher::T_ghough_params& rparams);
+
+
+    // Gets the bounding box of the non-zero pixels of a template mask (CV_8U)
+    // grown by a margin and clipped to the image.  Whole image is returned if mask is empty.
+    cv::Rect get_ghough_mask_roi(
+        const cv::Mat& rmask,
+        const int margin);
+
+
+    // Same as below but only gradients of foreground pixels enter the table.
+    // Mask (CV_8U) is non-zero for foreground.  It is dilated by half the Sobel kernel size
+    // so gradients of the outline of the object (which spread over the kernel) are kept.
+    // No GUI calls are made.
+    void init_ghough_table_from_img(
+        cv::Mat& rimg,
+        const cv::Mat& rmask,
+        BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_params& rparams,
+        cv::Mat& rgrad);
+
+
+    // Same as above but the encoded gradient image of the template is returned
+    // instead of being shown.  This one does no GUI calls so it is safe to use
+    // from a background thread.
+    void init_ghough_table_from_img(
+        cv::Mat& rimg,
+        BGHMatcher::T_ghough_table& rtable,
+        const BGHMatcher::T_ghough_params& rparams,
+        cv::Mat& rgrad);
 }
 
 #endif // BGH_MATCHER_H_
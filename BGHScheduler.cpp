@@ -0,0 +1,273 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+
+#include "BGHScheduler.h"
+#include "BGHSimd.h"
+
+
+// minimum band height in output rows
+#define MIN_BAND_ROWS   (8)
+
+// target number of tasks per worker so stealing has something to balance
+#define TASKS_PER_WORKER    (8)
+
+
+namespace BGHMatcher
+{
+    GHoughScheduler::GHoughScheduler(const int worker_ct) :
+        run_id(0),
+        is_stopping(false),
+        remaining_ct(0),
+        pimg(nullptr),
+        pvtables(nullptr),
+        scanned_ct(0)
+    {
+        int n = worker_ct;
+        if (n < 1)
+        {
+            n = std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+
+        for (int id = 0; id < n; id++)
+        {
+            queues.push_back(std::unique_ptr<T_queue>(new T_queue));
+        }
+
+        // calling thread is worker 0
+        for (int id = 1; id < n; id++)
+        {
+            threads.push_back(std::thread(&GHoughScheduler::worker, this, id));
+        }
+    }
+
+
+    GHoughScheduler::~GHoughScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(run_mtx);
+            is_stopping = true;
+        }
+        run_cv.notify_all();
+        for (auto& rthread : threads)
+        {
+            rthread.join();
+        }
+    }
+
+
+    void GHoughScheduler::run(
+        const cv::Mat& rimg,
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        std::vector<BGHMatcher::T_ghough_peak>& rvpeaks)
+    {
+        pimg = &rimg;
+        pvtables = &rvtables;
+        split_jobs();
+
+        // outputs must be ready before first task is queued because a worker
+        // still finishing the previous run may pick it up right away
+        vtask_peaks.assign(vtasks.size(), T_ghough_peak());
+        remaining_ct = static_cast<int>(vtasks.size());
+
+        // hand tasks out round-robin, biggest first,
+        // so every queue starts with a similar mix
+        std::vector<size_t> vorder(vtasks.size());
+        for (size_t k = 0; k < vorder.size(); k++)
+        {
+            vorder[k] = k;
+        }
+        std::stable_sort(vorder.begin(), vorder.end(), [&](const size_t a, const size_t b)
+        {
+            const double qa = static_cast<double>(vtasks[a].r1 - vtasks[a].r0) * rvtables[vtasks[a].job]->total_entries;
+            const double qb = static_cast<double>(vtasks[b].r1 - vtasks[b].r0) * rvtables[vtasks[b].job]->total_entries;
+            return qa > qb;
+        });
+
+        for (size_t k = 0; k < vorder.size(); k++)
+        {
+            T_queue& rqueue = *queues[k % queues.size()];
+            std::lock_guard<std::mutex> lock(rqueue.mtx);
+            rqueue.tasks.push_back(vtasks[vorder[k]]);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(run_mtx);
+            run_id++;
+        }
+        run_cv.notify_all();
+
+        do_tasks(0);
+
+        {
+            std::unique_lock<std::mutex> lock(run_mtx);
+            done_cv.wait(lock, [this] { return remaining_ct == 0; });
+        }
+
+        // merge band peaks into job peaks
+        // ties go to first location in raster order like cv::minMaxLoc
+        rvpeaks.assign(rvtables.size(), T_ghough_peak());
+        std::vector<bool> vfound(rvtables.size(), false);
+        for (size_t k = 0; k < vtasks.size(); k++)
+        {
+            const T_ghough_peak& rband = vtask_peaks[k];
+            T_ghough_peak& rpeak = rvpeaks[vtasks[k].job];
+            const bool is_first = !vfound[vtasks[k].job];
+            if (is_first || (rband.qmax > rpeak.qmax) ||
+                ((rband.qmax == rpeak.qmax) &&
+                ((rband.ptmax.y < rpeak.ptmax.y) ||
+                ((rband.ptmax.y == rpeak.ptmax.y) && (rband.ptmax.x < rpeak.ptmax.x)))))
+            {
+                rpeak = rband;
+                vfound[vtasks[k].job] = true;
+            }
+        }
+
+        for (size_t job = 0; job < rvtables.size(); job++)
+        {
+            const size_t total_votes = rvtables[job]->total_votes;
+            rvpeaks[job].score = (total_votes) ? (rvpeaks[job].qmax / total_votes) : 0.0;
+        }
+    }
+
+
+    void GHoughScheduler::split_jobs(void)
+    {
+        const int rows = pimg->rows;
+        const std::vector<const T_ghough_table *>& rvtables = *pvtables;
+
+        // cost of a job is proportional to rows times table entries
+        // so pick a target task cost that gives several tasks per worker
+        double total_cost = 0.0;
+        for (const auto& rptable : rvtables)
+        {
+            total_cost += static_cast<double>(rows) * std::max<size_t>(1, rptable->total_entries);
+        }
+        const double task_cost = std::max(1.0, total_cost / (queues.size() * TASKS_PER_WORKER));
+
+        vtasks.clear();
+        scanned_ct = 0;
+        for (size_t job = 0; job < rvtables.size(); job++)
+        {
+            const double entries = static_cast<double>(std::max<size_t>(1, rvtables[job]->total_entries));
+            int band_rows = static_cast<int>(task_cost / entries);
+
+            // a band scans its rows plus the extent height so a band shorter
+            // than the extent would spend most of its time rescanning rows
+            const cv::Rect ext = get_ghough_table_extent(*rvtables[job]);
+            band_rows = std::max(band_rows, ext.height);
+            band_rows = std::max(MIN_BAND_ROWS, std::min(rows, band_rows));
+
+            // same input range as apply_ghough_transform_roi for a full-width band
+            const int j0 = std::max<int>(1, -(ext.x + ext.width - 1));
+            const int j1 = std::min<int>(pimg->cols - 1, pimg->cols - ext.x);
+            for (int r0 = 0; r0 < rows; r0 += band_rows)
+            {
+                T_task task = { vtasks.size(), job, r0, std::min(rows, r0 + band_rows) };
+                vtasks.push_back(task);
+
+                const int i0 = std::max<int>(1, task.r0 - (ext.y + ext.height - 1));
+                const int i1 = std::min<int>(rows - 1, task.r1 - ext.y);
+                scanned_ct += static_cast<size_t>(std::max(0, i1 - i0)) * std::max(0, j1 - j0);
+            }
+        }
+    }
+
+
+    bool GHoughScheduler::get_task(const int id, T_task& rtask)
+    {
+        // newest task from own queue
+        {
+            T_queue& rqueue = *queues[id];
+            std::lock_guard<std::mutex> lock(rqueue.mtx);
+            if (!rqueue.tasks.empty())
+            {
+                rtask = rqueue.tasks.back();
+                rqueue.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // oldest task from another queue
+        const int n = get_worker_ct();
+        for (int k = 1; k < n; k++)
+        {
+            T_queue& rqueue = *queues[(id + k) % n];
+            std::lock_guard<std::mutex> lock(rqueue.mtx);
+            if (!rqueue.tasks.empty())
+            {
+                rtask = rqueue.tasks.front();
+                rqueue.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    void GHoughScheduler::do_tasks(const int id)
+    {
+        // tasks never create new tasks so all queues being
+        // empty means there is nothing left to take in this run
+        T_task task;
+        cv::Mat img_band;
+        while (get_task(id, task))
+        {
+            const T_ghough_table& rtable = *(*pvtables)[task.job];
+            const cv::Rect roi = { 0, task.r0, pimg->cols, task.r1 - task.r0 };
+            apply_ghough_transform_roi<CV_32F, float>(*pimg, img_band, rtable, roi);
+
+            // each task writes its own slot so no lock is needed
+            T_ghough_peak peak;
+            find_ghough_max(img_band, peak.qmax, peak.ptmax);
+            peak.ptmax.y += task.r0;
+            vtask_peaks[task.index] = peak;
+
+            if (--remaining_ct == 0)
+            {
+                std::lock_guard<std::mutex> lock(run_mtx);
+                done_cv.notify_all();
+            }
+        }
+    }
+
+
+    void GHoughScheduler::worker(const int id)
+    {
+        unsigned int last_run_id = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(run_mtx);
+                run_cv.wait(lock, [&] { return is_stopping || (run_id != last_run_id); });
+                if (is_stopping)
+                {
+                    break;
+                }
+                last_run_id = run_id;
+            }
+            do_tasks(id);
+        }
+    }
+}
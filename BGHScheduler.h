@@ -0,0 +1,112 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BGH_SCHEDULER_H_
+#define BGH_SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BGHMatcher.h"
+
+namespace BGHMatcher
+{
+    // Runs many Generalized Hough searches on one encoded gradient image in parallel.
+    // Every table is a job.  Jobs are split into bands of output rows and the band
+    // height of each job is scaled by its table entry count so tasks have similar cost.
+    // A band must scan its own rows plus the table extent height so bands are never
+    // shorter than the extent.  This keeps the rescanned rows below half of all scanned rows.
+    // Every worker has its own task queue.  A worker pops tasks from the back of its own
+    // queue and when that is empty it steals from the front of the other queues.
+    // The calling thread works too, so a scheduler with 1 worker starts no threads.
+    class GHoughScheduler
+    {
+    public:
+
+        // Creates scheduler with a number of workers (0 is one per hardware thread).
+        GHoughScheduler(const int worker_ct = 0);
+        virtual ~GHoughScheduler();
+
+        int get_worker_ct(void) const { return static_cast<int>(queues.size()); }
+
+        // Gets number of input pixels visited by all tasks in last run.
+        size_t get_scanned_ct(void) const { return scanned_ct; }
+
+        // Votes with every table and finds the peak of each job.
+        // Results match running apply_ghough_transform_allpix and cv::minMaxLoc per table.
+        void run(
+            const cv::Mat& rimg,
+            const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+            std::vector<BGHMatcher::T_ghough_peak>& rvpeaks);
+
+    private:
+
+        typedef struct
+        {
+            size_t index;
+            size_t job;
+            int r0;
+            int r1;
+        } T_task;
+
+        typedef struct
+        {
+            std::mutex mtx;
+            std::deque<T_task> tasks;
+        } T_queue;
+
+        void split_jobs(void);
+        bool get_task(const int id, T_task& rtask);
+        void do_tasks(const int id);
+        void worker(const int id);
+
+        // Threads and their queues (queue 0 belongs to the calling thread)
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<T_queue>> queues;
+
+        // Signals workers when a new run starts or when scheduler is shutting down
+        std::mutex run_mtx;
+        std::condition_variable run_cv;
+        std::condition_variable done_cv;
+        unsigned int run_id;
+        bool is_stopping;
+
+        // Tasks not yet finished in current run
+        std::atomic<int> remaining_ct;
+
+        // Inputs and per-task outputs for current run
+        const cv::Mat * pimg;
+        const std::vector<const BGHMatcher::T_ghough_table *> * pvtables;
+        std::vector<T_task> vtasks;
+        std::vector<BGHMatcher::T_ghough_peak> vtask_peaks;
+
+        // Input pixels visited by all tasks in current run
+        size_t scanned_ct;
+    };
+}
+
+#endif // BGH_SCHEDULER_H_
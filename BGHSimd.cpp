@@ -0,0 +1,364 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "BGHSimd.h"
+
+#if defined(BGH_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+namespace BGHMatcher
+{
+    // names for BGH_SIMD environment variable and log messages (same order as enum)
+    static const char * SIMD_NAMES[] = { "scalar", "sse42", "avx2", "avx512" };
+
+
+#if defined(BGH_SIMD_X86)
+    // reads the cpuid registers EAX, EBX, ECX, EDX for a leaf and subleaf
+    static void get_cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t r[4])
+    {
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int k = 0; k < 4; k++)
+        {
+            r[k] = static_cast<uint32_t>(regs[k]);
+        }
+#else
+        __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+    }
+
+
+    // reads the XCR0 register which says which vector registers the OS saves
+    static uint64_t get_xcr0(void)
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t lo;
+        uint32_t hi;
+        __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+    }
+#endif
+
+
+    int get_simd_cpu_isa(void)
+    {
+        int isa = SIMD_SCALAR;
+#if defined(BGH_SIMD_X86)
+        uint32_t r[4];
+        get_cpuid(0, 0, r);
+        const uint32_t max_leaf = r[0];
+
+        get_cpuid(1, 0, r);
+        const bool is_sse41 = ((r[2] >> 19) & 1) != 0;
+        const bool is_sse42 = ((r[2] >> 20) & 1) != 0;
+        const bool is_osxsave = ((r[2] >> 27) & 1) != 0;
+        const bool is_avx = ((r[2] >> 28) & 1) != 0;
+
+        // the CPU having AVX isn't enough, the OS must also save the YMM and ZMM registers
+        const uint64_t xcr0 = (is_osxsave) ? get_xcr0() : 0;
+        const bool is_ymm_saved = ((xcr0 & 0x06) == 0x06);
+        const bool is_zmm_saved = ((xcr0 & 0xE6) == 0xE6);
+
+        uint32_t ebx7 = 0;
+        if (max_leaf >= 7)
+        {
+            get_cpuid(7, 0, r);
+            ebx7 = r[1];
+        }
+        const bool is_avx2 = ((ebx7 >> 5) & 1) != 0;
+        const bool is_avx512f = ((ebx7 >> 16) & 1) != 0;
+        const bool is_avx512bw = ((ebx7 >> 30) & 1) != 0;
+        const bool is_avx512vl = ((ebx7 >> 31) & 1) != 0;
+
+        if (is_sse41 && is_sse42)
+        {
+            isa = SIMD_SSE42;
+            if (is_avx && is_avx2 && is_ymm_saved)
+            {
+                isa = SIMD_AVX2;
+#if defined(BGH_SIMD_AVX512)
+                if (is_avx512f && is_avx512bw && is_avx512vl && is_zmm_saved)
+                {
+                    isa = SIMD_AVX512;
+                }
+#endif
+            }
+        }
+#endif
+        return isa;
+    }
+
+
+    // picks the kernels from cpuid and the optional override
+    static T_simd_kernels select_simd_kernels(void)
+    {
+        const int cpu_isa = get_simd_cpu_isa();
+        int isa = cpu_isa;
+
+        const char * senv = std::getenv("BGH_SIMD");
+        if (senv != nullptr)
+        {
+            const std::string sreq(senv);
+            const auto iter = std::find(std::begin(SIMD_NAMES), std::end(SIMD_NAMES), sreq);
+            if (iter == std::end(SIMD_NAMES))
+            {
+                std::cout << "BGH_SIMD=" << sreq << " is unknown, ignoring it" << std::endl;
+            }
+            else if ((iter - std::begin(SIMD_NAMES)) > cpu_isa)
+            {
+                std::cout << "BGH_SIMD=" << sreq << " is not supported by this CPU, ignoring it" << std::endl;
+            }
+            else
+            {
+                isa = static_cast<int>(iter - std::begin(SIMD_NAMES));
+            }
+        }
+
+        T_simd_kernels kernels;
+        get_simd_kernels_scalar(kernels);
+#if defined(BGH_SIMD_X86)
+        switch (isa)
+        {
+            case SIMD_SSE42: get_simd_kernels_sse42(kernels); break;
+            case SIMD_AVX2: get_simd_kernels_avx2(kernels); break;
+#if defined(BGH_SIMD_AVX512)
+            case SIMD_AVX512: get_simd_kernels_avx512(kernels); break;
+#endif
+            default: break;
+        }
+#endif
+
+        std::cout << "SIMD kernels: " << kernels.name;
+        std::cout << " (CPU supports " << SIMD_NAMES[cpu_isa] << ")" << std::endl;
+        return kernels;
+    }
+
+
+    const BGHMatcher::T_simd_kernels& get_simd_kernels(void)
+    {
+        // initialization of a local static is thread-safe and happens once
+        static const T_simd_kernels kernels = select_simd_kernels();
+        return kernels;
+    }
+
+
+    void encode_row_scalar(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n,
+        const float scale,
+        const int code_ct)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            int c = cvRound(pang[j] * scale + 1.0f);
+            c = std::min(255, std::max(0, c));
+            c = (c == (code_ct + 1)) ? 1 : c;
+            pcode[j] = (pmask[j]) ? static_cast<uint8_t>(c) : 0;
+        }
+    }
+
+
+    int argmax_row_f32_scalar(const float * p, const int n)
+    {
+        int k = 0;
+        for (int j = 1; j < n; j++)
+        {
+            k = (p[j] > p[k]) ? j : k;
+        }
+        return k;
+    }
+
+
+    int argmax_row_u16_scalar(const uint16_t * p, const int n)
+    {
+        int k = 0;
+        for (int j = 1; j < n; j++)
+        {
+            k = (p[j] > p[k]) ? j : k;
+        }
+        return k;
+    }
+
+
+    void scale_row_f32_scalar(
+        const float * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            pdst[j] = cv::saturate_cast<uint8_t>(p[j] * alpha + beta);
+        }
+    }
+
+
+    void scale_row_u16_scalar(
+        const uint16_t * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            pdst[j] = cv::saturate_cast<uint8_t>(static_cast<float>(p[j]) * alpha + beta);
+        }
+    }
+
+
+    void fold_row_scalar(
+        const float * pvotes,
+        float * pbest,
+        uint16_t * pid,
+        const int n,
+        const float scale,
+        const uint16_t id)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            const float s = pvotes[j] * scale;
+            if (s > pbest[j])
+            {
+                pbest[j] = s;
+                pid[j] = id;
+            }
+        }
+    }
+
+
+    void get_simd_kernels_scalar(BGHMatcher::T_simd_kernels& rk)
+    {
+        rk.isa = SIMD_SCALAR;
+        rk.name = SIMD_NAMES[SIMD_SCALAR];
+        rk.encode_row = encode_row_scalar;
+        rk.encode_row_coded[0] = encode_row_coded_scalar<8>;
+        rk.encode_row_coded[1] = encode_row_coded_scalar<16>;
+        rk.encode_row_coded[2] = encode_row_coded_scalar<32>;
+        rk.encode_row_coded[3] = encode_row_coded_scalar<64>;
+        rk.argmax_row_f32 = argmax_row_f32_scalar;
+        rk.argmax_row_u16 = argmax_row_u16_scalar;
+        rk.scale_row_f32 = scale_row_f32_scalar;
+        rk.scale_row_u16 = scale_row_u16_scalar;
+        rk.fold_row = fold_row_scalar;
+    }
+
+
+    void find_ghough_max(
+        const cv::Mat& rimg,
+        double& rqmax,
+        cv::Point& rptmax)
+    {
+        const bool is_f32 = (rimg.type() == CV_32F);
+        if (rimg.empty() || (!is_f32 && (rimg.type() != CV_16U)))
+        {
+            cv::minMaxLoc(rimg, nullptr, &rqmax, nullptr, &rptmax);
+            return;
+        }
+
+        // only a greater value in a later row replaces the best
+        // so ties go to the first location in raster order
+        const T_simd_kernels& rk = get_simd_kernels();
+        rqmax = 0.0;
+        rptmax = { 0, 0 };
+        for (int i = 0; i < rimg.rows; i++)
+        {
+            double q;
+            int j;
+            if (is_f32)
+            {
+                const float * p = rimg.ptr<float>(i);
+                j = rk.argmax_row_f32(p, rimg.cols);
+                q = p[j];
+            }
+            else
+            {
+                const uint16_t * p = rimg.ptr<uint16_t>(i);
+                j = rk.argmax_row_u16(p, rimg.cols);
+                q = p[j];
+            }
+            if ((i == 0) || (q > rqmax))
+            {
+                rqmax = q;
+                rptmax = { j, i };
+            }
+        }
+    }
+
+
+    void create_ghough_display_img(
+        const cv::Mat& rimg,
+        cv::Mat& rdisp)
+    {
+        const bool is_f32 = (rimg.type() == CV_32F);
+        if (rimg.empty() || (!is_f32 && (rimg.type() != CV_16U)))
+        {
+            cv::Mat temp;
+            cv::normalize(rimg, temp, 0, 255, cv::NORM_MINMAX);
+            temp.convertTo(rdisp, CV_8U);
+            return;
+        }
+
+        // same scale and offset as a min-max normalization
+        double qmin;
+        double qmax;
+        cv::minMaxLoc(rimg, &qmin, &qmax);
+        const double range = qmax - qmin;
+        const double alpha = (range > DBL_EPSILON) ? (255.0 / range) : 0.0;
+        const float falpha = static_cast<float>(alpha);
+        const float fbeta = static_cast<float>(-qmin * alpha);
+
+        const T_simd_kernels& rk = get_simd_kernels();
+        rdisp.create(rimg.size(), CV_8U);
+        for (int i = 0; i < rimg.rows; i++)
+        {
+            if (is_f32)
+            {
+                rk.scale_row_f32(rimg.ptr<float>(i), rdisp.ptr<uint8_t>(i), rimg.cols, falpha, fbeta);
+            }
+            else
+            {
+                rk.scale_row_u16(rimg.ptr<uint16_t>(i), rdisp.ptr<uint8_t>(i), rimg.cols, falpha, fbeta);
+            }
+        }
+    }
+}
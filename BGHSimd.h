@@ -0,0 +1,187 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BGH_SIMD_H_
+#define BGH_SIMD_H_
+
+#include <cstdint>
+
+#include "opencv2/core.hpp"
+
+// vector kernels only exist for x86 and x64 builds
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BGH_SIMD_X86
+#endif
+
+// AVX-512 intrinsics need VS 2017 (15.3) or later
+#if defined(BGH_SIMD_X86) && (!defined(_MSC_VER) || (_MSC_VER >= 1911))
+#define BGH_SIMD_AVX512
+#endif
+
+// GCC and Clang need a target attribute to emit instructions above the build baseline.
+// MSVC emits any intrinsic without it so the rest of the program stays at the baseline.
+#if defined(_MSC_VER)
+#define BGH_TARGET(isa)
+#else
+#define BGH_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace BGHMatcher
+{
+    // instruction sets in order of preference
+    enum
+    {
+        SIMD_SCALAR = 0,
+        SIMD_SSE42,
+        SIMD_AVX2,
+        SIMD_AVX512,
+    };
+
+
+    // Table of row kernels for one instruction set.
+    // Every kernel has a scalar version so all pointers are valid for any selection.
+    // Only the kernels in this table have vector versions.  Voting (the scatter of table
+    // entries into the accumulator) is not in the table and has no vector version
+    // since its random access pattern doesn't vectorize.  Callers use these kernels only
+    // for the image types named below and fall back to OpenCV for anything else.
+    typedef struct _T_simd_kernels_struct
+    {
+        int isa;
+        const char * name;
+
+        // encodes angles (0-2pi) as gradient codes: round(angle*scale + 1) saturated to 8 bits,
+        // code (code_ct+1) changed to 1, and code 0 where the mask is 0
+        void(*encode_row)(
+            const float * pang, const uint8_t * pmask, uint8_t * pcode,
+            const int n, const float scale, const int code_ct);
+
+        // same as encode_row for a code count N of 8, 16, 32, or 64 fixed at compile time
+        // so the scale is a constant and the wrap of code N+1 to 1 is a bit mask
+        // index is log2(N) - 3 (see get_simd_coded_index)
+        void(*encode_row_coded[4])(
+            const float * pang, const uint8_t * pmask, uint8_t * pcode, const int n);
+
+        // returns index of first maximum in a row (n > 0)
+        int(*argmax_row_f32)(const float * p, const int n);
+        int(*argmax_row_u16)(const uint16_t * p, const int n);
+
+        // converts a row to 8 bits for display: round(value*alpha + beta) saturated to 8 bits
+        void(*scale_row_f32)(const float * p, uint8_t * pdst, const int n, const float alpha, const float beta);
+        void(*scale_row_u16)(const uint16_t * p, uint8_t * pdst, const int n, const float alpha, const float beta);
+
+        // folds a row of votes into a running maximum: score is votes*scale
+        // and best score and ID are replaced where score is greater than best score
+        void(*fold_row)(
+            const float * pvotes, float * pbest, uint16_t * pid,
+            const int n, const float scale, const uint16_t id);
+
+        _T_simd_kernels_struct() :
+            isa(SIMD_SCALAR), name("scalar"),
+            encode_row(nullptr), encode_row_coded{ nullptr, nullptr, nullptr, nullptr },
+            argmax_row_f32(nullptr), argmax_row_u16(nullptr),
+            scale_row_f32(nullptr), scale_row_u16(nullptr), fold_row(nullptr) {}
+    } T_simd_kernels;
+
+
+    // Returns the best instruction set this CPU, OS, and build support (from cpuid).
+    int get_simd_cpu_isa(void);
+
+
+    // Returns the kernels to use in this process.  They are selected on the first call
+    // from cpuid and a line naming the selected path is printed.
+    // The BGH_SIMD environment variable (scalar, sse42, avx2, or avx512) overrides the
+    // selection for testing.  An instruction set the CPU doesn't support is never selected.
+    const BGHMatcher::T_simd_kernels& get_simd_kernels(void);
+
+
+    // Fills a kernel table for one instruction set.
+    // Each instruction set is in its own translation unit.
+    void get_simd_kernels_scalar(BGHMatcher::T_simd_kernels& rk);
+    void get_simd_kernels_sse42(BGHMatcher::T_simd_kernels& rk);
+    void get_simd_kernels_avx2(BGHMatcher::T_simd_kernels& rk);
+    void get_simd_kernels_avx512(BGHMatcher::T_simd_kernels& rk);
+
+
+    // Scalar row kernels.
+    // The vector kernels use these for the pixels left over at the end of a row.
+    void encode_row_scalar(
+        const float * pang, const uint8_t * pmask, uint8_t * pcode,
+        const int n, const float scale, const int code_ct);
+    int argmax_row_f32_scalar(const float * p, const int n);
+    int argmax_row_u16_scalar(const uint16_t * p, const int n);
+    void scale_row_f32_scalar(const float * p, uint8_t * pdst, const int n, const float alpha, const float beta);
+    void scale_row_u16_scalar(const uint16_t * p, uint8_t * pdst, const int n, const float alpha, const float beta);
+    void fold_row_scalar(
+        const float * pvotes, float * pbest, uint16_t * pid,
+        const int n, const float scale, const uint16_t id);
+
+
+    // Scalar row encoder for a code count N (power of 2) fixed at compile time.
+    // Angles are 0-2pi so codes are 1 to N+1 before the wrap and the mask gives the same
+    // result as the compare in encode_row_scalar.
+    template<int N>
+    void encode_row_coded_scalar(
+        const float * pang, const uint8_t * pmask, uint8_t * pcode, const int n)
+    {
+        static_assert((N > 0) && ((N & (N - 1)) == 0), "code count must be a power of 2");
+        constexpr float SCALE = static_cast<float>(N / CV_2PI);
+        for (int j = 0; j < n; j++)
+        {
+            const int c = cvRound(pang[j] * SCALE + 1.0f);
+            pcode[j] = (pmask[j]) ? static_cast<uint8_t>(((c - 1) & (N - 1)) + 1) : 0;
+        }
+    }
+
+
+    // Gets index into encode_row_coded for a code count of 8, 16, 32, or 64.
+    // Returns -1 for any other code count.
+    inline int get_simd_coded_index(const int code_ct)
+    {
+        switch (code_ct)
+        {
+            case 8: return 0;
+            case 16: return 1;
+            case 32: return 2;
+            case 64: return 3;
+            default: return -1;
+        }
+    }
+
+
+    // Finds maximum value and its location in an image.
+    // Same result as cv::minMaxLoc (first maximum in raster order).
+    // Uses the selected kernels for CV_32F and CV_16U images.
+    void find_ghough_max(
+        const cv::Mat& rimg,
+        double& rqmax,
+        cv::Point& rptmax);
+
+
+    // Creates an 8-bit display image of a match result.
+    // Same result as normalizing to 0-255 (cv::NORM_MINMAX) and converting to CV_8U.
+    // Uses the selected kernels for CV_32F and CV_16U images.
+    void create_ghough_display_img(
+        const cv::Mat& rimg,
+        cv::Mat& rdisp);
+}
+
+#endif // BGH_SIMD_H_
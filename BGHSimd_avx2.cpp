@@ -0,0 +1,306 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "BGHSimd.h"
+
+#if defined(BGH_SIMD_X86)
+
+#include <immintrin.h>
+
+#define TARGET_AVX2 BGH_TARGET("avx2")
+
+
+namespace BGHMatcher
+{
+    // returns index of lowest set bit of a nonzero mask
+    static int get_first_bit(const uint32_t mask)
+    {
+        int k = 0;
+        while (((mask >> k) & 1) == 0)
+        {
+            k++;
+        }
+        return k;
+    }
+
+
+    // packs 4 vectors of 32-bit integers into 32 bytes with unsigned saturation
+    // the packs work within 128-bit lanes so a final permute restores the order
+    TARGET_AVX2 static __m256i pack_u8(const __m256i c0, const __m256i c1, const __m256i c2, const __m256i c3)
+    {
+        const __m256i c = _mm256_packus_epi16(_mm256_packs_epi32(c0, c1), _mm256_packs_epi32(c2, c3));
+        return _mm256_permutevar8x32_epi32(c, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    }
+
+
+    TARGET_AVX2 static __m256i encode_avx2(const float * pang, const __m256 vscale, const __m256 vone)
+    {
+        return _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pang), vscale), vone));
+    }
+
+
+    TARGET_AVX2 static void encode_row_avx2(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n,
+        const float scale,
+        const int code_ct)
+    {
+        const __m256 vscale = _mm256_set1_ps(scale);
+        const __m256 vone = _mm256_set1_ps(1.0f);
+        const __m256i vwrap = _mm256_set1_epi8(static_cast<char>(code_ct + 1));
+        const __m256i vcode1 = _mm256_set1_epi8(1);
+        const __m256i vzero = _mm256_setzero_si256();
+        int j = 0;
+        for (; (j + 32) <= n; j += 32)
+        {
+            __m256i c = pack_u8(
+                encode_avx2(pang + j + 0, vscale, vone),
+                encode_avx2(pang + j + 8, vscale, vone),
+                encode_avx2(pang + j + 16, vscale, vone),
+                encode_avx2(pang + j + 24, vscale, vone));
+            c = _mm256_blendv_epi8(c, vcode1, _mm256_cmpeq_epi8(c, vwrap));
+            const __m256i vmask0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pmask + j)), vzero);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pcode + j), _mm256_andnot_si256(vmask0, c));
+        }
+        encode_row_scalar(pang + j, pmask + j, pcode + j, n - j, scale, code_ct);
+    }
+
+
+    template<int N>
+    TARGET_AVX2 static void encode_row_coded_avx2(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n)
+    {
+        const __m256 vscale = _mm256_set1_ps(static_cast<float>(N / CV_2PI));
+        const __m256 vone = _mm256_set1_ps(1.0f);
+        const __m256i vbits = _mm256_set1_epi8(static_cast<char>(N - 1));
+        const __m256i vcode1 = _mm256_set1_epi8(1);
+        const __m256i vzero = _mm256_setzero_si256();
+        int j = 0;
+        for (; (j + 32) <= n; j += 32)
+        {
+            __m256i c = pack_u8(
+                encode_avx2(pang + j + 0, vscale, vone),
+                encode_avx2(pang + j + 8, vscale, vone),
+                encode_avx2(pang + j + 16, vscale, vone),
+                encode_avx2(pang + j + 24, vscale, vone));
+            c = _mm256_add_epi8(_mm256_and_si256(_mm256_sub_epi8(c, vcode1), vbits), vcode1);
+            const __m256i vmask0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pmask + j)), vzero);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pcode + j), _mm256_andnot_si256(vmask0, c));
+        }
+        encode_row_coded_scalar<N>(pang + j, pmask + j, pcode + j, n - j);
+    }
+
+
+    TARGET_AVX2 static int argmax_row_f32_avx2(const float * p, const int n)
+    {
+        if (n < 8)
+        {
+            return argmax_row_f32_scalar(p, n);
+        }
+
+        // find the maximum then the first element equal to it
+        int j = 8;
+        __m256 vmax8 = _mm256_loadu_ps(p);
+        for (; (j + 8) <= n; j += 8)
+        {
+            vmax8 = _mm256_max_ps(vmax8, _mm256_loadu_ps(p + j));
+        }
+        __m128 vmax = _mm_max_ps(_mm256_castps256_ps128(vmax8), _mm256_extractf128_ps(vmax8, 1));
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+        float qmax = _mm_cvtss_f32(vmax);
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax8 = _mm256_set1_ps(qmax);
+        for (j = 0; (j + 8) <= n; j += 8)
+        {
+            const int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(p + j), vmax8, _CMP_EQ_OQ));
+            if (mask)
+            {
+                return j + get_first_bit(static_cast<uint32_t>(mask));
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_AVX2 static int argmax_row_u16_avx2(const uint16_t * p, const int n)
+    {
+        if (n < 16)
+        {
+            return argmax_row_u16_scalar(p, n);
+        }
+
+        // maximum of x is the complement of the minimum of its complement
+        int j = 16;
+        __m256i vmax16 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        for (; (j + 16) <= n; j += 16)
+        {
+            vmax16 = _mm256_max_epu16(vmax16, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + j)));
+        }
+        const __m128i vmax = _mm_max_epu16(_mm256_castsi256_si128(vmax16), _mm256_extracti128_si256(vmax16, 1));
+        const __m128i vmin = _mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)));
+        uint16_t qmax = static_cast<uint16_t>(~_mm_cvtsi128_si32(vmin));
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax16 = _mm256_set1_epi16(static_cast<short>(qmax));
+        for (j = 0; (j + 16) <= n; j += 16)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + j));
+            const int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vmax16));
+            if (mask)
+            {
+                return j + get_first_bit(static_cast<uint32_t>(mask)) / 2;
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_AVX2 static __m256i scale_f32_avx2(const __m256 v, const __m256 valpha, const __m256 vbeta)
+    {
+        return _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(v, valpha), vbeta));
+    }
+
+
+    TARGET_AVX2 static __m256i scale_u16_avx2(const uint16_t * p, const __m256 valpha, const __m256 vbeta)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        return scale_f32_avx2(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v)), valpha, vbeta);
+    }
+
+
+    TARGET_AVX2 static void scale_row_f32_avx2(
+        const float * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m256 valpha = _mm256_set1_ps(alpha);
+        const __m256 vbeta = _mm256_set1_ps(beta);
+        int j = 0;
+        for (; (j + 32) <= n; j += 32)
+        {
+            const __m256i c = pack_u8(
+                scale_f32_avx2(_mm256_loadu_ps(p + j + 0), valpha, vbeta),
+                scale_f32_avx2(_mm256_loadu_ps(p + j + 8), valpha, vbeta),
+                scale_f32_avx2(_mm256_loadu_ps(p + j + 16), valpha, vbeta),
+                scale_f32_avx2(_mm256_loadu_ps(p + j + 24), valpha, vbeta));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pdst + j), c);
+        }
+        scale_row_f32_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_AVX2 static void scale_row_u16_avx2(
+        const uint16_t * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m256 valpha = _mm256_set1_ps(alpha);
+        const __m256 vbeta = _mm256_set1_ps(beta);
+        int j = 0;
+        for (; (j + 32) <= n; j += 32)
+        {
+            const __m256i c = pack_u8(
+                scale_u16_avx2(p + j + 0, valpha, vbeta),
+                scale_u16_avx2(p + j + 8, valpha, vbeta),
+                scale_u16_avx2(p + j + 16, valpha, vbeta),
+                scale_u16_avx2(p + j + 24, valpha, vbeta));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pdst + j), c);
+        }
+        scale_row_u16_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_AVX2 static void fold_row_avx2(
+        const float * pvotes,
+        float * pbest,
+        uint16_t * pid,
+        const int n,
+        const float scale,
+        const uint16_t id)
+    {
+        const __m256 vscale = _mm256_set1_ps(scale);
+        const __m256i vid = _mm256_set1_epi16(static_cast<short>(id));
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m256 s0 = _mm256_mul_ps(_mm256_loadu_ps(pvotes + j + 0), vscale);
+            const __m256 s1 = _mm256_mul_ps(_mm256_loadu_ps(pvotes + j + 8), vscale);
+            const __m256 b0 = _mm256_loadu_ps(pbest + j + 0);
+            const __m256 b1 = _mm256_loadu_ps(pbest + j + 8);
+            const __m256 m0 = _mm256_cmp_ps(s0, b0, _CMP_GT_OQ);
+            const __m256 m1 = _mm256_cmp_ps(s1, b1, _CMP_GT_OQ);
+            _mm256_storeu_ps(pbest + j + 0, _mm256_blendv_ps(b0, s0, m0));
+            _mm256_storeu_ps(pbest + j + 8, _mm256_blendv_ps(b1, s1, m1));
+
+            // pack the masks to 16 bits then put the 64-bit quarters back in order
+            __m256i m = _mm256_packs_epi32(_mm256_castps_si256(m0), _mm256_castps_si256(m1));
+            m = _mm256_permute4x64_epi64(m, 0xD8);
+            const __m256i vold = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pid + j));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pid + j), _mm256_blendv_epi8(vold, vid, m));
+        }
+        fold_row_scalar(pvotes + j, pbest + j, pid + j, n - j, scale, id);
+    }
+
+
+    void get_simd_kernels_avx2(BGHMatcher::T_simd_kernels& rk)
+    {
+        rk.isa = SIMD_AVX2;
+        rk.name = "avx2";
+        rk.encode_row = encode_row_avx2;
+        rk.encode_row_coded[0] = encode_row_coded_avx2<8>;
+        rk.encode_row_coded[1] = encode_row_coded_avx2<16>;
+        rk.encode_row_coded[2] = encode_row_coded_avx2<32>;
+        rk.encode_row_coded[3] = encode_row_coded_avx2<64>;
+        rk.argmax_row_f32 = argmax_row_f32_avx2;
+        rk.argmax_row_u16 = argmax_row_u16_avx2;
+        rk.scale_row_f32 = scale_row_f32_avx2;
+        rk.scale_row_u16 = scale_row_u16_avx2;
+        rk.fold_row = fold_row_avx2;
+    }
+}
+
+#endif // BGH_SIMD_X86
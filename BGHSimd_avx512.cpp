@@ -0,0 +1,268 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "BGHSimd.h"
+
+#if defined(BGH_SIMD_AVX512)
+
+#include <immintrin.h>
+
+#define TARGET_AVX512 BGH_TARGET("avx512f,avx512bw,avx512vl")
+
+
+namespace BGHMatcher
+{
+    // returns index of lowest set bit of a nonzero mask
+    static int get_first_bit(const uint32_t mask)
+    {
+        int k = 0;
+        while (((mask >> k) & 1) == 0)
+        {
+            k++;
+        }
+        return k;
+    }
+
+
+    // narrows 16 32-bit integers to 16 bytes with unsigned saturation (negative values become 0)
+    TARGET_AVX512 static __m128i narrow_u8(const __m512i c)
+    {
+        return _mm512_cvtusepi32_epi8(_mm512_max_epi32(c, _mm512_setzero_si512()));
+    }
+
+
+    // returns x*a + b with the multiply and add rounded separately like the scalar kernels
+    // an add with an explicit rounding mode can't be fused into an FMA by the compiler
+    TARGET_AVX512 static __m512 mul_add(const __m512 x, const __m512 a, const __m512 b)
+    {
+        return _mm512_add_round_ps(_mm512_mul_ps(x, a), b, _MM_FROUND_CUR_DIRECTION);
+    }
+
+
+    TARGET_AVX512 static void encode_row_avx512(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n,
+        const float scale,
+        const int code_ct)
+    {
+        const __m512 vscale = _mm512_set1_ps(scale);
+        const __m512 vone = _mm512_set1_ps(1.0f);
+        const __m128i vwrap = _mm_set1_epi8(static_cast<char>(code_ct + 1));
+        const __m128i vcode1 = _mm_set1_epi8(1);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m512 v = mul_add(_mm512_loadu_ps(pang + j), vscale, vone);
+            __m128i c = narrow_u8(_mm512_cvtps_epi32(v));
+            c = _mm_mask_blend_epi8(_mm_cmpeq_epi8_mask(c, vwrap), c, vcode1);
+            const __m128i vmask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pmask + j));
+            c = _mm_maskz_mov_epi8(_mm_test_epi8_mask(vmask, vmask), c);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pcode + j), c);
+        }
+        encode_row_scalar(pang + j, pmask + j, pcode + j, n - j, scale, code_ct);
+    }
+
+
+    template<int N>
+    TARGET_AVX512 static void encode_row_coded_avx512(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n)
+    {
+        const __m512 vscale = _mm512_set1_ps(static_cast<float>(N / CV_2PI));
+        const __m512 vone = _mm512_set1_ps(1.0f);
+        const __m128i vbits = _mm_set1_epi8(static_cast<char>(N - 1));
+        const __m128i vcode1 = _mm_set1_epi8(1);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m512 v = mul_add(_mm512_loadu_ps(pang + j), vscale, vone);
+            __m128i c = narrow_u8(_mm512_cvtps_epi32(v));
+            c = _mm_add_epi8(_mm_and_si128(_mm_sub_epi8(c, vcode1), vbits), vcode1);
+            const __m128i vmask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pmask + j));
+            c = _mm_maskz_mov_epi8(_mm_test_epi8_mask(vmask, vmask), c);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pcode + j), c);
+        }
+        encode_row_coded_scalar<N>(pang + j, pmask + j, pcode + j, n - j);
+    }
+
+
+    TARGET_AVX512 static int argmax_row_f32_avx512(const float * p, const int n)
+    {
+        if (n < 16)
+        {
+            return argmax_row_f32_scalar(p, n);
+        }
+
+        // find the maximum then the first element equal to it
+        int j = 16;
+        __m512 vmax = _mm512_loadu_ps(p);
+        for (; (j + 16) <= n; j += 16)
+        {
+            vmax = _mm512_max_ps(vmax, _mm512_loadu_ps(p + j));
+        }
+        float qmax = _mm512_reduce_max_ps(vmax);
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax = _mm512_set1_ps(qmax);
+        for (j = 0; (j + 16) <= n; j += 16)
+        {
+            const __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(p + j), vmax, _CMP_EQ_OQ);
+            if (mask)
+            {
+                return j + get_first_bit(mask);
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_AVX512 static int argmax_row_u16_avx512(const uint16_t * p, const int n)
+    {
+        if (n < 32)
+        {
+            return argmax_row_u16_scalar(p, n);
+        }
+
+        // maximum of x is the complement of the minimum of its complement
+        int j = 32;
+        __m512i vmax32 = _mm512_loadu_si512(p);
+        for (; (j + 32) <= n; j += 32)
+        {
+            vmax32 = _mm512_max_epu16(vmax32, _mm512_loadu_si512(p + j));
+        }
+        const __m256i vmax16 = _mm256_max_epu16(_mm512_castsi512_si256(vmax32), _mm512_extracti64x4_epi64(vmax32, 1));
+        const __m128i vmax = _mm_max_epu16(_mm256_castsi256_si128(vmax16), _mm256_extracti128_si256(vmax16, 1));
+        const __m128i vmin = _mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)));
+        uint16_t qmax = static_cast<uint16_t>(~_mm_cvtsi128_si32(vmin));
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax32 = _mm512_set1_epi16(static_cast<short>(qmax));
+        for (j = 0; (j + 32) <= n; j += 32)
+        {
+            const __mmask32 mask = _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(p + j), vmax32);
+            if (mask)
+            {
+                return j + get_first_bit(mask);
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_AVX512 static void scale_row_f32_avx512(
+        const float * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m512 valpha = _mm512_set1_ps(alpha);
+        const __m512 vbeta = _mm512_set1_ps(beta);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m512 v = mul_add(_mm512_loadu_ps(p + j), valpha, vbeta);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pdst + j), narrow_u8(_mm512_cvtps_epi32(v)));
+        }
+        scale_row_f32_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_AVX512 static void scale_row_u16_avx512(
+        const uint16_t * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m512 valpha = _mm512_set1_ps(alpha);
+        const __m512 vbeta = _mm512_set1_ps(beta);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m256i vu = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + j));
+            const __m512 v = mul_add(_mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(vu)), valpha, vbeta);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pdst + j), narrow_u8(_mm512_cvtps_epi32(v)));
+        }
+        scale_row_u16_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_AVX512 static void fold_row_avx512(
+        const float * pvotes,
+        float * pbest,
+        uint16_t * pid,
+        const int n,
+        const float scale,
+        const uint16_t id)
+    {
+        const __m512 vscale = _mm512_set1_ps(scale);
+        const __m256i vid = _mm256_set1_epi16(static_cast<short>(id));
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            // masked stores only write the pixels that improved
+            const __m512 s = _mm512_mul_ps(_mm512_loadu_ps(pvotes + j), vscale);
+            const __mmask16 mask = _mm512_cmp_ps_mask(s, _mm512_loadu_ps(pbest + j), _CMP_GT_OQ);
+            _mm512_mask_storeu_ps(pbest + j, mask, s);
+            _mm256_mask_storeu_epi16(pid + j, mask, vid);
+        }
+        fold_row_scalar(pvotes + j, pbest + j, pid + j, n - j, scale, id);
+    }
+
+
+    void get_simd_kernels_avx512(BGHMatcher::T_simd_kernels& rk)
+    {
+        rk.isa = SIMD_AVX512;
+        rk.name = "avx512";
+        rk.encode_row = encode_row_avx512;
+        rk.encode_row_coded[0] = encode_row_coded_avx512<8>;
+        rk.encode_row_coded[1] = encode_row_coded_avx512<16>;
+        rk.encode_row_coded[2] = encode_row_coded_avx512<32>;
+        rk.encode_row_coded[3] = encode_row_coded_avx512<64>;
+        rk.argmax_row_f32 = argmax_row_f32_avx512;
+        rk.argmax_row_u16 = argmax_row_u16_avx512;
+        rk.scale_row_f32 = scale_row_f32_avx512;
+        rk.scale_row_u16 = scale_row_u16_avx512;
+        rk.fold_row = fold_row_avx512;
+    }
+}
+
+#endif // BGH_SIMD_AVX512
@@ -0,0 +1,290 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "BGHSimd.h"
+
+#if defined(BGH_SIMD_X86)
+
+#include <nmmintrin.h>
+
+#define TARGET_SSE42 BGH_TARGET("sse4.2")
+
+
+namespace BGHMatcher
+{
+    // returns index of lowest set bit of a nonzero mask
+    static int get_first_bit(const int mask)
+    {
+        int k = 0;
+        while (((mask >> k) & 1) == 0)
+        {
+            k++;
+        }
+        return k;
+    }
+
+
+    // packs 4 vectors of 32-bit integers into 16 bytes with unsigned saturation
+    TARGET_SSE42 static __m128i pack_u8(const __m128i c0, const __m128i c1, const __m128i c2, const __m128i c3)
+    {
+        return _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+    }
+
+
+    TARGET_SSE42 static void encode_row_sse42(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n,
+        const float scale,
+        const int code_ct)
+    {
+        const __m128 vscale = _mm_set1_ps(scale);
+        const __m128 vone = _mm_set1_ps(1.0f);
+        const __m128i vwrap = _mm_set1_epi8(static_cast<char>(code_ct + 1));
+        const __m128i vcode1 = _mm_set1_epi8(1);
+        const __m128i vzero = _mm_setzero_si128();
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m128i c0 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 0), vscale), vone));
+            const __m128i c1 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 4), vscale), vone));
+            const __m128i c2 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 8), vscale), vone));
+            const __m128i c3 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 12), vscale), vone));
+            __m128i c = pack_u8(c0, c1, c2, c3);
+            c = _mm_blendv_epi8(c, vcode1, _mm_cmpeq_epi8(c, vwrap));
+            const __m128i vmask0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pmask + j)), vzero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pcode + j), _mm_andnot_si128(vmask0, c));
+        }
+        encode_row_scalar(pang + j, pmask + j, pcode + j, n - j, scale, code_ct);
+    }
+
+
+    template<int N>
+    TARGET_SSE42 static void encode_row_coded_sse42(
+        const float * pang,
+        const uint8_t * pmask,
+        uint8_t * pcode,
+        const int n)
+    {
+        const __m128 vscale = _mm_set1_ps(static_cast<float>(N / CV_2PI));
+        const __m128 vone = _mm_set1_ps(1.0f);
+        const __m128i vbits = _mm_set1_epi8(static_cast<char>(N - 1));
+        const __m128i vcode1 = _mm_set1_epi8(1);
+        const __m128i vzero = _mm_setzero_si128();
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m128i c0 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 0), vscale), vone));
+            const __m128i c1 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 4), vscale), vone));
+            const __m128i c2 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 8), vscale), vone));
+            const __m128i c3 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pang + j + 12), vscale), vone));
+            __m128i c = pack_u8(c0, c1, c2, c3);
+            c = _mm_add_epi8(_mm_and_si128(_mm_sub_epi8(c, vcode1), vbits), vcode1);
+            const __m128i vmask0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pmask + j)), vzero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pcode + j), _mm_andnot_si128(vmask0, c));
+        }
+        encode_row_coded_scalar<N>(pang + j, pmask + j, pcode + j, n - j);
+    }
+
+
+    TARGET_SSE42 static int argmax_row_f32_sse42(const float * p, const int n)
+    {
+        if (n < 4)
+        {
+            return argmax_row_f32_scalar(p, n);
+        }
+
+        // find the maximum then the first element equal to it
+        int j = 4;
+        __m128 vmax = _mm_loadu_ps(p);
+        for (; (j + 4) <= n; j += 4)
+        {
+            vmax = _mm_max_ps(vmax, _mm_loadu_ps(p + j));
+        }
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+        float qmax = _mm_cvtss_f32(vmax);
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax = _mm_set1_ps(qmax);
+        for (j = 0; (j + 4) <= n; j += 4)
+        {
+            const int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(p + j), vmax));
+            if (mask)
+            {
+                return j + get_first_bit(mask);
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_SSE42 static int argmax_row_u16_sse42(const uint16_t * p, const int n)
+    {
+        if (n < 8)
+        {
+            return argmax_row_u16_scalar(p, n);
+        }
+
+        // maximum of x is the complement of the minimum of its complement
+        // which is one instruction for 8 unsigned 16-bit values
+        int j = 8;
+        const __m128i vones = _mm_set1_epi16(-1);
+        __m128i vmax = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        for (; (j + 8) <= n; j += 8)
+        {
+            vmax = _mm_max_epu16(vmax, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j)));
+        }
+        const __m128i vmin = _mm_minpos_epu16(_mm_xor_si128(vmax, vones));
+        uint16_t qmax = static_cast<uint16_t>(~_mm_cvtsi128_si32(vmin));
+        for (; j < n; j++)
+        {
+            qmax = (p[j] > qmax) ? p[j] : qmax;
+        }
+
+        vmax = _mm_set1_epi16(static_cast<short>(qmax));
+        for (j = 0; (j + 8) <= n; j += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j));
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vmax));
+            if (mask)
+            {
+                return j + get_first_bit(mask) / 2;
+            }
+        }
+        while (p[j] != qmax)
+        {
+            j++;
+        }
+        return j;
+    }
+
+
+    TARGET_SSE42 static __m128i scale_f32_sse42(const __m128 v, const __m128 valpha, const __m128 vbeta)
+    {
+        return _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(v, valpha), vbeta));
+    }
+
+
+    TARGET_SSE42 static void scale_row_f32_sse42(
+        const float * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m128 valpha = _mm_set1_ps(alpha);
+        const __m128 vbeta = _mm_set1_ps(beta);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m128i c0 = scale_f32_sse42(_mm_loadu_ps(p + j + 0), valpha, vbeta);
+            const __m128i c1 = scale_f32_sse42(_mm_loadu_ps(p + j + 4), valpha, vbeta);
+            const __m128i c2 = scale_f32_sse42(_mm_loadu_ps(p + j + 8), valpha, vbeta);
+            const __m128i c3 = scale_f32_sse42(_mm_loadu_ps(p + j + 12), valpha, vbeta);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pdst + j), pack_u8(c0, c1, c2, c3));
+        }
+        scale_row_f32_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_SSE42 static void scale_row_u16_sse42(
+        const uint16_t * p,
+        uint8_t * pdst,
+        const int n,
+        const float alpha,
+        const float beta)
+    {
+        const __m128 valpha = _mm_set1_ps(alpha);
+        const __m128 vbeta = _mm_set1_ps(beta);
+        int j = 0;
+        for (; (j + 16) <= n; j += 16)
+        {
+            const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j + 0));
+            const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j + 8));
+            const __m128i c0 = scale_f32_sse42(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(v0)), valpha, vbeta);
+            const __m128i c1 = scale_f32_sse42(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v0, 8))), valpha, vbeta);
+            const __m128i c2 = scale_f32_sse42(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(v1)), valpha, vbeta);
+            const __m128i c3 = scale_f32_sse42(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v1, 8))), valpha, vbeta);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pdst + j), pack_u8(c0, c1, c2, c3));
+        }
+        scale_row_u16_scalar(p + j, pdst + j, n - j, alpha, beta);
+    }
+
+
+    TARGET_SSE42 static void fold_row_sse42(
+        const float * pvotes,
+        float * pbest,
+        uint16_t * pid,
+        const int n,
+        const float scale,
+        const uint16_t id)
+    {
+        const __m128 vscale = _mm_set1_ps(scale);
+        const __m128i vid = _mm_set1_epi16(static_cast<short>(id));
+        int j = 0;
+        for (; (j + 8) <= n; j += 8)
+        {
+            const __m128 s0 = _mm_mul_ps(_mm_loadu_ps(pvotes + j + 0), vscale);
+            const __m128 s1 = _mm_mul_ps(_mm_loadu_ps(pvotes + j + 4), vscale);
+            const __m128 b0 = _mm_loadu_ps(pbest + j + 0);
+            const __m128 b1 = _mm_loadu_ps(pbest + j + 4);
+            const __m128 m0 = _mm_cmpgt_ps(s0, b0);
+            const __m128 m1 = _mm_cmpgt_ps(s1, b1);
+            _mm_storeu_ps(pbest + j + 0, _mm_blendv_ps(b0, s0, m0));
+            _mm_storeu_ps(pbest + j + 4, _mm_blendv_ps(b1, s1, m1));
+
+            // all-ones and all-zeros masks stay that way when packed to 16 bits
+            const __m128i m = _mm_packs_epi32(_mm_castps_si128(m0), _mm_castps_si128(m1));
+            const __m128i vold = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pid + j));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pid + j), _mm_blendv_epi8(vold, vid, m));
+        }
+        fold_row_scalar(pvotes + j, pbest + j, pid + j, n - j, scale, id);
+    }
+
+
+    void get_simd_kernels_sse42(BGHMatcher::T_simd_kernels& rk)
+    {
+        rk.isa = SIMD_SSE42;
+        rk.name = "sse42";
+        rk.encode_row = encode_row_sse42;
+        rk.encode_row_coded[0] = encode_row_coded_sse42<8>;
+        rk.encode_row_coded[1] = encode_row_coded_sse42<16>;
+        rk.encode_row_coded[2] = encode_row_coded_sse42<32>;
+        rk.encode_row_coded[3] = encode_row_coded_sse42<64>;
+        rk.argmax_row_f32 = argmax_row_f32_sse42;
+        rk.argmax_row_u16 = argmax_row_u16_sse42;
+        rk.scale_row_f32 = scale_row_f32_sse42;
+        rk.scale_row_u16 = scale_row_u16_sse42;
+        rk.fold_row = fold_row_sse42;
+    }
+}
+
+#endif // BGH_SIMD_X86
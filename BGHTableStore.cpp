@@ -0,0 +1,452 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "BGHTableStore.h"
+
+
+// "BGHT" and format version
+#define STORE_MAGIC     (0x54484742u)
+#define STORE_VERSION   (2u)
+
+
+namespace BGHMatcher
+{
+    // flat format is a header, an array of record offsets, and then for each table
+    // a record followed by its entry counts (one per code) and all of its entries
+    // every part starts on an 8-byte boundary
+    // header has record and entry sizes so a reader built with a different layout rejects the buffer
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t entry_size;
+        uint64_t size;
+        uint64_t table_ct;
+    } T_store_header;
+
+    // table parameters and symmetry are stored as fixed width fields (no padding)
+    // instead of the in-memory structures whose layout can change
+    typedef struct
+    {
+        double scale;
+        double mag_thr;
+        double ang_step;
+        double sym_angle;
+        double sym_score;
+        int32_t kblur;
+        int32_t ksobel;
+        int32_t nms_tol;
+        int32_t max_vote_pix;
+        int32_t sym_order;
+        int32_t sym_code_shift;
+        int32_t width;
+        int32_t height;
+        int32_t bin;
+        int32_t is_compressed;
+        uint64_t elem_ct;
+        uint64_t total_votes;
+        uint64_t total_entries;
+        uint64_t counts_offset;
+        uint64_t entries_offset;
+    } T_store_record;
+
+    static_assert(sizeof(T_store_header) == 32, "flat store header must not have padding");
+    static_assert(sizeof(T_store_record) == 120, "flat store record must not have padding");
+
+
+    static size_t align8(const size_t n)
+    {
+        return (n + 7) & ~static_cast<size_t>(7);
+    }
+
+
+    size_t get_flat_ghough_tables_size(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables)
+    {
+        size_t n = align8(sizeof(T_store_header) + rvtables.size() * sizeof(uint64_t));
+        for (const auto& rptable : rvtables)
+        {
+            n += align8(sizeof(T_store_record));
+            n += align8(rptable->elem_ct * sizeof(uint64_t));
+            n += align8(rptable->total_entries * sizeof(T_pt_votes));
+        }
+        return n;
+    }
+
+
+    void flatten_ghough_tables(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        void * pbuf)
+    {
+        uint8_t * pbyte = static_cast<uint8_t *>(pbuf);
+        T_store_header * phdr = reinterpret_cast<T_store_header *>(pbyte);
+        uint64_t * poffsets = reinterpret_cast<uint64_t *>(pbyte + sizeof(T_store_header));
+
+        // magic is written last so a reader never accepts a partly written buffer
+        phdr->magic = 0;
+        phdr->version = STORE_VERSION;
+        phdr->record_size = sizeof(T_store_record);
+        phdr->entry_size = sizeof(T_pt_votes);
+        phdr->size = get_flat_ghough_tables_size(rvtables);
+        phdr->table_ct = rvtables.size();
+
+        size_t n = align8(sizeof(T_store_header) + rvtables.size() * sizeof(uint64_t));
+        for (size_t k = 0; k < rvtables.size(); k++)
+        {
+            const T_ghough_table& rtable = *rvtables[k];
+            poffsets[k] = n;
+
+            T_store_record * prec = reinterpret_cast<T_store_record *>(pbyte + n);
+            n += align8(sizeof(T_store_record));
+            prec->scale = rtable.params.scale;
+            prec->mag_thr = rtable.params.mag_thr;
+            prec->ang_step = rtable.params.ang_step;
+            prec->sym_angle = rtable.sym.angle;
+            prec->sym_score = rtable.sym.score;
+            prec->kblur = rtable.params.kblur;
+            prec->ksobel = rtable.params.ksobel;
+            prec->nms_tol = rtable.params.nms_tol;
+            prec->max_vote_pix = rtable.params.max_vote_pix;
+            prec->sym_order = rtable.sym.order;
+            prec->sym_code_shift = rtable.sym.code_shift;
+            prec->width = rtable.img_sz.width;
+            prec->height = rtable.img_sz.height;
+            prec->bin = rtable.bin;
+            prec->is_compressed = (rtable.is_compressed) ? 1 : 0;
+            prec->elem_ct = rtable.elem_ct;
+            prec->total_votes = rtable.total_votes;
+            prec->total_entries = rtable.total_entries;
+
+            prec->counts_offset = n;
+            uint64_t * pcounts = reinterpret_cast<uint64_t *>(pbyte + n);
+            n += align8(rtable.elem_ct * sizeof(uint64_t));
+
+            prec->entries_offset = n;
+            T_pt_votes * pentries = reinterpret_cast<T_pt_votes *>(pbyte + n);
+            n += align8(rtable.total_entries * sizeof(T_pt_votes));
+
+            // entries emptied by edits are left out so counts add up to total entries
+            for (size_t key = 0; key < rtable.elem_ct; key++)
+            {
+                const T_ghough_elem& relem = rtable.elems[key];
+                pcounts[key] = 0;
+                for (size_t k = 0; k < relem.ct; k++)
+                {
+                    if (relem.pt_votes[k].votes)
+                    {
+                        *pentries++ = relem.pt_votes[k];
+                        pcounts[key]++;
+                    }
+                }
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_release);
+        phdr->magic = STORE_MAGIC;
+    }
+
+
+    // checks that one table record and all of its counts and entries are inside the buffer
+    // every check subtracts from the size so an offset or count can't overflow it
+    static bool is_flat_record_valid(
+        const uint8_t * pbyte,
+        const size_t buf_size,
+        const uint64_t rec_offset)
+    {
+        if ((rec_offset % 8) || (rec_offset > buf_size) ||
+            ((buf_size - rec_offset) < sizeof(T_store_record)))
+        {
+            return false;
+        }
+
+        const T_store_record * prec = reinterpret_cast<const T_store_record *>(pbyte + rec_offset);
+        if ((prec->counts_offset % 8) || (prec->counts_offset > buf_size) ||
+            (prec->elem_ct > ((buf_size - prec->counts_offset) / sizeof(uint64_t))))
+        {
+            return false;
+        }
+        if ((prec->entries_offset % 8) || (prec->entries_offset > buf_size))
+        {
+            return false;
+        }
+
+        // sum of counts must fit in the entry array and match the total
+        const uint64_t * pcounts = reinterpret_cast<const uint64_t *>(pbyte + prec->counts_offset);
+        const uint64_t entry_max = (buf_size - prec->entries_offset) / sizeof(T_pt_votes);
+        uint64_t entry_ct = 0;
+        for (uint64_t key = 0; key < prec->elem_ct; key++)
+        {
+            if (pcounts[key] > (entry_max - entry_ct))
+            {
+                return false;
+            }
+            entry_ct += pcounts[key];
+        }
+        return (entry_ct == prec->total_entries);
+    }
+
+
+    bool attach_flat_ghough_tables(
+        const void * pbuf,
+        const size_t buf_size,
+        std::vector<BGHMatcher::T_ghough_table>& rvtables)
+    {
+        rvtables.clear();
+        const uint8_t * pbyte = static_cast<const uint8_t *>(pbuf);
+        const T_store_header * phdr = reinterpret_cast<const T_store_header *>(pbyte);
+        if ((buf_size < sizeof(T_store_header)) ||
+            (phdr->magic != STORE_MAGIC) ||
+            (phdr->version != STORE_VERSION) ||
+            (phdr->record_size != sizeof(T_store_record)) ||
+            (phdr->entry_size != sizeof(T_pt_votes)) ||
+            (phdr->size > buf_size))
+        {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // everything past the size in the header is ignored
+        // and every offset and count must stay within it
+        const size_t size = static_cast<size_t>(phdr->size);
+        if ((size < sizeof(T_store_header)) ||
+            (phdr->table_ct > ((size - sizeof(T_store_header)) / sizeof(uint64_t))))
+        {
+            return false;
+        }
+        const uint64_t * poffsets = reinterpret_cast<const uint64_t *>(pbyte + sizeof(T_store_header));
+        for (uint64_t k = 0; k < phdr->table_ct; k++)
+        {
+            if (!is_flat_record_valid(pbyte, size, poffsets[k]))
+            {
+                return false;
+            }
+        }
+
+        // tables can't be copied so they are set up in place
+        rvtables.resize(static_cast<size_t>(phdr->table_ct));
+        for (size_t k = 0; k < rvtables.size(); k++)
+        {
+            const T_store_record * prec = reinterpret_cast<const T_store_record *>(pbyte + poffsets[k]);
+            const uint64_t * pcounts = reinterpret_cast<const uint64_t *>(pbyte + prec->counts_offset);
+            const T_pt_votes * pentries = reinterpret_cast<const T_pt_votes *>(pbyte + prec->entries_offset);
+
+            T_ghough_table& rtable = rvtables[k];
+            rtable.elem_ct = static_cast<size_t>(prec->elem_ct);
+            rtable.elems = new T_ghough_elem[rtable.elem_ct];
+            rtable.is_view = true;
+            for (size_t key = 0; key < rtable.elem_ct; key++)
+            {
+                // entries are never written through a view table
+                rtable.elems[key].ct = static_cast<size_t>(pcounts[key]);
+                rtable.elems[key].pt_votes = const_cast<T_pt_votes *>(pentries);
+                pentries += pcounts[key];
+            }
+
+            rtable.params.scale = prec->scale;
+            rtable.params.mag_thr = prec->mag_thr;
+            rtable.params.ang_step = prec->ang_step;
+            rtable.params.kblur = prec->kblur;
+            rtable.params.ksobel = prec->ksobel;
+            rtable.params.nms_tol = prec->nms_tol;
+            rtable.params.max_vote_pix = prec->max_vote_pix;
+            rtable.sym.order = prec->sym_order;
+            rtable.sym.code_shift = prec->sym_code_shift;
+            rtable.sym.angle = prec->sym_angle;
+            rtable.sym.score = prec->sym_score;
+            rtable.img_sz = { prec->width, prec->height };
+            rtable.bin = prec->bin;
+            rtable.is_compressed = (prec->is_compressed != 0);
+            rtable.total_votes = static_cast<size_t>(prec->total_votes);
+            rtable.total_entries = static_cast<size_t>(prec->total_entries);
+        }
+
+        return true;
+    }
+
+
+    GHoughTableStore::GHoughTableStore() :
+        pbase(nullptr),
+        size(0),
+        is_owner(false)
+#ifdef _WIN32
+        , hmap(nullptr)
+#else
+        , fd(-1)
+#endif
+    {
+    }
+
+
+    GHoughTableStore::~GHoughTableStore()
+    {
+        close();
+    }
+
+
+    bool GHoughTableStore::publish(
+        const std::string& rsname,
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables)
+    {
+        close();
+        if (!map_segment(rsname, get_flat_ghough_tables_size(rvtables), true))
+        {
+            return false;
+        }
+        flatten_ghough_tables(rvtables, pbase);
+        return true;
+    }
+
+
+    bool GHoughTableStore::attach(const std::string& rsname)
+    {
+        close();
+        if (!map_segment(rsname, 0, false))
+        {
+            return false;
+        }
+        if (!attach_flat_ghough_tables(pbase, size, vtables))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+
+    void GHoughTableStore::close(void)
+    {
+        // views must go away before the memory they point to
+        vtables.clear();
+
+#ifdef _WIN32
+        if (pbase != nullptr)
+        {
+            UnmapViewOfFile(pbase);
+        }
+        if (hmap != nullptr)
+        {
+            CloseHandle(hmap);
+        }
+        hmap = nullptr;
+#else
+        if (pbase != nullptr)
+        {
+            munmap(pbase, size);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        if (is_owner)
+        {
+            shm_unlink(sname.c_str());
+        }
+        fd = -1;
+#endif
+
+        pbase = nullptr;
+        size = 0;
+        is_owner = false;
+        sname.clear();
+    }
+
+
+    bool GHoughTableStore::map_segment(const std::string& rsname, const size_t seg_size, const bool is_create)
+    {
+        sname = rsname;
+        is_owner = is_create;
+
+#ifdef _WIN32
+        if (is_create)
+        {
+            const uint64_t n = seg_size;
+            hmap = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                static_cast<DWORD>(n >> 32), static_cast<DWORD>(n & 0xFFFFFFFFu), rsname.c_str());
+
+            // an existing mapping can't be removed while some process has it open
+            // and writing new tables over it would change memory a reader still has mapped
+            if ((hmap != nullptr) && (GetLastError() == ERROR_ALREADY_EXISTS))
+            {
+                CloseHandle(hmap);
+                hmap = nullptr;
+            }
+            pbase = (hmap != nullptr) ? MapViewOfFile(hmap, FILE_MAP_ALL_ACCESS, 0, 0, seg_size) : nullptr;
+            size = seg_size;
+        }
+        else
+        {
+            // whole segment is mapped and its real size (rounded up to pages) comes from the view
+            // header size is only trusted after it has been checked against this
+            hmap = OpenFileMappingA(FILE_MAP_READ, FALSE, rsname.c_str());
+            pbase = (hmap != nullptr) ? MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            MEMORY_BASIC_INFORMATION mbi;
+            if ((pbase != nullptr) && (VirtualQuery(pbase, &mbi, sizeof(mbi)) == sizeof(mbi)))
+            {
+                size = static_cast<size_t>(mbi.RegionSize);
+            }
+        }
+#else
+        if (is_create)
+        {
+            // a stale segment left by a publisher that crashed is removed first
+            // so the new one never reuses (or truncates) memory a reader still has mapped
+            shm_unlink(rsname.c_str());
+            fd = shm_open(rsname.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if ((fd >= 0) && (ftruncate(fd, static_cast<off_t>(seg_size)) == 0))
+            {
+                void * p = mmap(nullptr, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                pbase = (p != MAP_FAILED) ? p : nullptr;
+                size = seg_size;
+            }
+        }
+        else
+        {
+            struct stat st;
+            fd = shm_open(rsname.c_str(), O_RDONLY, 0);
+            if ((fd >= 0) && (fstat(fd, &st) == 0) && (st.st_size > 0))
+            {
+                void * p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                pbase = (p != MAP_FAILED) ? p : nullptr;
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+#endif
+
+        if (pbase == nullptr)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,118 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BGH_TABLE_STORE_H_
+#define BGH_TABLE_STORE_H_
+
+#include <string>
+#include <vector>
+
+#include "BGHMatcher.h"
+
+#ifdef _WIN32
+#include "Windows.h"
+#endif
+
+namespace BGHMatcher
+{
+    // Gets number of bytes needed to store a set of tables in the flat format.
+    size_t get_flat_ghough_tables_size(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables);
+
+
+    // Writes a set of tables to a buffer in a flat format with no pointers.
+    // Everything is located by byte offsets from the start of the buffer
+    // so the buffer can be mapped at a different address in every process.
+    // Table parameters are written as fixed width fields and the header has the format
+    // version and the record and entry sizes, which a reader must match.
+    // Buffer must be at least the size given by get_flat_ghough_tables_size
+    // and aligned to 8 bytes.
+    void flatten_ghough_tables(
+        const std::vector<const BGHMatcher::T_ghough_table *>& rvtables,
+        void * pbuf);
+
+
+    // Creates view tables for every table in a flat buffer.
+    // Entries are not copied.  View tables point into the buffer
+    // so the buffer must stay valid and unchanged while they exist.
+    // Every offset and entry count is checked against the buffer size first.
+    // Returns false if buffer does not have valid flat tables.
+    bool attach_flat_ghough_tables(
+        const void * pbuf,
+        const size_t buf_size,
+        std::vector<BGHMatcher::T_ghough_table>& rvtables);
+
+
+    // Read-only table store in a named shared memory segment.
+    // A publisher process builds the tables and publishes them once.
+    // Reader processes attach to the segment and get view tables without building anything,
+    // so all processes on a host share one physical copy of the entries.
+    // Uses POSIX shm_open and mmap (name should start with '/') or a Windows file mapping.
+    // On POSIX the publisher removes the name when it closes but readers that are already
+    // attached keep working.  Publishing removes any segment left with the same name and
+    // always creates a new one.  On Windows the segment lives while any process has it open
+    // and publishing fails if a segment with the same name is still open.
+    // A store owns its mapping so it can't be copied.
+    class GHoughTableStore
+    {
+    public:
+
+        GHoughTableStore();
+        virtual ~GHoughTableStore();
+
+        GHoughTableStore(const GHoughTableStore&) = delete;
+        GHoughTableStore& operator=(const GHoughTableStore&) = delete;
+
+        // Creates segment and writes tables to it.  Returns false if segment can't be created.
+        bool publish(
+            const std::string& rsname,
+            const std::vector<const BGHMatcher::T_ghough_table *>& rvtables);
+
+        // Maps an existing segment read-only and creates view tables.
+        // Returns false if segment doesn't exist or doesn't have valid tables.
+        bool attach(const std::string& rsname);
+
+        // Releases view tables and unmaps segment.
+        void close(void);
+
+        // Tables in the segment (empty unless attached)
+        const std::vector<BGHMatcher::T_ghough_table>& get_tables(void) const { return vtables; }
+
+    private:
+
+        bool map_segment(const std::string& rsname, const size_t size, const bool is_create);
+
+        std::string sname;
+        void * pbase;
+        size_t size;
+        bool is_owner;
+        std::vector<BGHMatcher::T_ghough_table> vtables;
+
+#ifdef _WIN32
+        HANDLE hmap;
+#else
+        int fd;
+#endif
+    };
+}
+
+#endif // BGH_TABLE_STORE_H_
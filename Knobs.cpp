@@ -28,16 +28,27 @@
 Knobs::Knobs() :
     is_op_required(false),
     is_equ_hist_enabled(false),
+    is_gate_enabled(false),
+    is_interleave_enabled(false),
+    is_tracking_enabled(false),
+    is_pose_enabled(false),
     is_record_enabled(false),
     kpreblur(7),
     kcliplimit(4),
     nchannel(Knobs::ALL_CHANNELS),
     noutmode(Knobs::OUT_COLOR),
     op_id(Knobs::OP_NONE),
+    knmstol(-1),
     nimgscale(3),
     nksize(4),
+    nmaxvotepix(0),
+    ngatethr(1),
+    ngatemaxage(1),
     vimgscale({ 0.25, 0.325, 0.4, 0.5, 0.625, 0.75, 1.0 }),
-    vksize({ -1, 1, 3, 5, 7})
+    vksize({ -1, 1, 3, 5, 7}),
+    vmaxvotepix({ 0, 2000, 5000, 10000 }),
+    vgatethr({ 1.0, 2.0, 4.0, 8.0 }),
+    vgatemaxage({ 10, 30, 100 })
 {
 }
 
@@ -59,7 +70,15 @@ void Knobs::show_help(void) const
     std::cout << "_ or +    Adjust CLAHE clip limit (decrease, increase)" << std::endl;
     std::cout << "[ or ]    Adjust image scale (decrease, increase)" << std::endl;
     std::cout << "{ or }    Adjust Sobel kernel size (decrease, increase)" << std::endl;
+    std::cout << "b         Cycle voting pixel limit (off, 2000, 5000, 10000)" << std::endl;
     std::cout << "e         Toggle histogram equalization" << std::endl;
+    std::cout << "g         Toggle skipping of unchanged frames" << std::endl;
+    std::cout << "h         Cycle unchanged frame threshold (1, 2, 4, 8)" << std::endl;
+    std::cout << "i         Toggle interleaved voting over multiple frames" << std::endl;
+    std::cout << "j         Cycle max skipped frames in a row (10, 30, 100)" << std::endl;
+    std::cout << "k         Toggle tracking between full searches" << std::endl;
+    std::cout << "n         Cycle edge thinning tolerance (off, 0, 1, 2)" << std::endl;
+    std::cout << "p         Toggle search over scale and rotation" << std::endl;
     std::cout << "r         Toggle recording mode" << std::endl;
     std::cout << "t         Select next template from collection" << std::endl;
     std::cout << "u         Update Hough parameters from current settings" << std::endl;
@@ -118,11 +137,58 @@ void Knobs::handle_keypress(const char ckey)
             op_id = Knobs::OP_UPDATE;
             break;
         }
+        case 'b':
+        {
+            inc_max_vote_pix();
+            is_op_required = true;
+            op_id = Knobs::OP_UPDATE;
+            break;
+        }
         case 'e':
         {
             toggle_equ_hist_enabled();
             break;
         }
+        case 'g':
+        {
+            toggle_gate_enabled();
+            break;
+        }
+        case 'h':
+        {
+            inc_gate_thr();
+            break;
+        }
+        case 'i':
+        {
+            toggle_interleave_enabled();
+            break;
+        }
+        case 'j':
+        {
+            inc_gate_max_age();
+            break;
+        }
+        case 'k':
+        {
+            toggle_tracking_enabled();
+            break;
+        }
+        case 'n':
+        {
+            inc_nms_tol();
+            is_op_required = true;
+            op_id = Knobs::OP_UPDATE;
+            break;
+        }
+        case 'p':
+        {
+            // template is rebuilt so its pose grid only exists while pose search is on
+            toggle_pose_enabled();
+            is_op_required = true;
+            op_id = Knobs::OP_UPDATE;
+            break;
+        }
         case 'r':
         {
             is_op_required = true;
@@ -168,6 +234,11 @@ void Knobs::handle_keypress(const char ckey)
         const std::vector<std::string> srgb({ "Blue ", "Green", "Red  ", "Gray " });
         const std::vector<std::string> sout({ "Raw  ", "Grad ", "Prep ", "Color" });
         std::cout << "Equ=" << is_equ_hist_enabled;
+        std::cout << "  Gate=" << is_gate_enabled;
+        std::cout << "," << vgatethr[ngatethr] << "," << vgatemaxage[ngatemaxage];
+        std::cout << "  Intlv=" << is_interleave_enabled;
+        std::cout << "  Track=" << is_tracking_enabled;
+        std::cout << "  Pose=" << is_pose_enabled;
         std::cout << "  Clip=" << kcliplimit;
         std::cout << "  Ch=" << srgb[nchannel];
         std::cout << "  Blur=" << kpreblur;
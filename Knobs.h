@@ -61,6 +61,18 @@ public:
     bool get_equ_hist_enabled(void) const { return is_equ_hist_enabled; }
     void toggle_equ_hist_enabled(void) { is_equ_hist_enabled = !is_equ_hist_enabled; }
 
+    bool get_gate_enabled(void) const { return is_gate_enabled; }
+    void toggle_gate_enabled(void) { is_gate_enabled = !is_gate_enabled; }
+
+    bool get_interleave_enabled(void) const { return is_interleave_enabled; }
+    void toggle_interleave_enabled(void) { is_interleave_enabled = !is_interleave_enabled; }
+
+    bool get_tracking_enabled(void) const { return is_tracking_enabled; }
+    void toggle_tracking_enabled(void) { is_tracking_enabled = !is_tracking_enabled; }
+
+    bool get_pose_enabled(void) const { return is_pose_enabled; }
+    void toggle_pose_enabled(void) { is_pose_enabled = !is_pose_enabled; }
+
     bool get_record_enabled(void) const { return is_record_enabled; }
     void toggle_record_enabled(void) { is_record_enabled = !is_record_enabled; }
 
@@ -86,6 +98,18 @@ public:
     void inc_ksize(void) { nksize = (nksize < (vksize.size() - 1)) ? nksize + 1 : nksize; }
     void dec_ksize(void) { nksize = (nksize > 0) ? nksize - 1 : nksize; };
 
+    int get_nms_tol(void) const { return knmstol; }
+    void inc_nms_tol(void) { knmstol = (knmstol < 2) ? knmstol + 1 : -1; }
+
+    int get_max_vote_pix(void) const { return vmaxvotepix[nmaxvotepix]; }
+    void inc_max_vote_pix(void) { nmaxvotepix = (nmaxvotepix + 1) % vmaxvotepix.size(); }
+
+    double get_gate_thr(void) const { return vgatethr[ngatethr]; }
+    void inc_gate_thr(void) { ngatethr = (ngatethr + 1) % vgatethr.size(); }
+
+    int get_gate_max_age(void) const { return vgatemaxage[ngatemaxage]; }
+    void inc_gate_max_age(void) { ngatemaxage = (ngatemaxage + 1) % vgatemaxage.size(); }
+
     void handle_keypress(const char c);
 
 private:
@@ -97,6 +121,18 @@ private:
     // Flag for enabling histogram equalization
     bool is_equ_hist_enabled;
 
+    // Flag for enabling reuse of results when scene is unchanged
+    bool is_gate_enabled;
+
+    // Flag for enabling interleaved voting over multiple frames
+    bool is_interleave_enabled;
+
+    // Flag for enabling tracking between full searches
+    bool is_tracking_enabled;
+
+    // Flag for enabling search over scale and rotation
+    bool is_pose_enabled;
+
     // Flag for enabling recording
     bool is_record_enabled;
 
@@ -115,17 +151,38 @@ private:
     // Type of operation that is required
     int op_id;
 
+    // Tolerance for gradient non-maximum suppression (-1 is off)
+    int knmstol;
+
     // Index of currently selected scale factor
     size_t nimgscale;
 
     // Index of currently selected Sobel kernel size
     size_t nksize;
 
+    // Index of currently selected voting pixel limit
+    size_t nmaxvotepix;
+
+    // Index of currently selected scene gate threshold
+    size_t ngatethr;
+
+    // Index of currently selected scene gate max reuse count
+    size_t ngatemaxage;
+
     // Array of supported scale factors
     std::vector<double> vimgscale;
 
     // Array of supported Sobel kernel sizes
     std::vector<int> vksize;
+
+    // Array of supported voting pixel limits (0 is no limit)
+    std::vector<int> vmaxvotepix;
+
+    // Array of supported scene gate thresholds (mean absolute difference 0-255)
+    std::vector<double> vgatethr;
+
+    // Array of supported scene gate max reuse counts (frames)
+    std::vector<int> vgatemaxage;
 };
 
 #endif // KNOBS_H_
@@ -0,0 +1,192 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+#include "TemplateLoader.h"
+
+
+// Reads a template as grayscale with an optional foreground mask.
+// Mask comes from the alpha channel or else from a "<stem>_mask.png" file next to the template.
+// Mask is empty if there is neither.  If there is a mask then the image is cropped to the
+// foreground with enough margin for the blur and Sobel kernels so the template box and
+// table offsets don't include empty border.
+static void read_template(
+    const std::string& rsfile,
+    const BGHMatcher::T_ghough_params& rparams,
+    cv::Mat& rimg,
+    cv::Mat& rmask)
+{
+    // file is decoded once and converted to grayscale here
+    cv::Mat img_raw = cv::imread(rsfile, cv::IMREAD_UNCHANGED);
+    rmask = cv::Mat();
+    if (img_raw.channels() == 4)
+    {
+        std::vector<cv::Mat> vchannels;
+        cv::split(img_raw, vchannels);
+        rmask = (vchannels[3] > 0);
+        cv::cvtColor(img_raw, rimg, cv::COLOR_BGRA2GRAY);
+    }
+    else
+    {
+        if (img_raw.channels() == 3)
+        {
+            cv::cvtColor(img_raw, rimg, cv::COLOR_BGR2GRAY);
+        }
+        else
+        {
+            rimg = img_raw;
+        }
+        const size_t n = rsfile.rfind('.');
+        const std::string sstem = (n == std::string::npos) ? rsfile : rsfile.substr(0, n);
+        cv::Mat img_mask = cv::imread(sstem + "_mask.png", cv::IMREAD_GRAYSCALE);
+        if (!img_mask.empty() && (img_mask.size() == rimg.size()))
+        {
+            rmask = (img_mask > 0);
+        }
+    }
+
+    // 16-bit files are scaled to 8 bits like a grayscale read would do
+    if (rimg.depth() == CV_16U)
+    {
+        rimg.convertTo(rimg, CV_8U, 1.0 / 256.0);
+    }
+
+    if (!rmask.empty())
+    {
+        const int margin = (rparams.kblur + std::abs(rparams.ksobel)) / 2 + 1;
+        const cv::Rect roi = BGHMatcher::get_ghough_mask_roi(rmask, margin);
+        rimg = rimg(roi).clone();
+        rmask = rmask(roi).clone();
+    }
+}
+
+
+TemplateLoader::TemplateLoader(const std::string& rspath) :
+    spath(rspath),
+    is_stopping(false),
+    is_requested(false),
+    req_is_pose(false)
+{
+    thread = std::thread(&TemplateLoader::worker, this);
+}
+
+
+TemplateLoader::~TemplateLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_stopping = true;
+    }
+    req_cv.notify_all();
+    thread.join();
+}
+
+
+std::shared_ptr<const T_template> TemplateLoader::load(
+    const T_file_info& rinfo,
+    const BGHMatcher::T_ghough_params& rparams,
+    const bool is_pose) const
+{
+    int64_t t0 = cv::getTickCount();
+    std::shared_ptr<T_template> ptemplate = std::make_shared<T_template>();
+    ptemplate->info = rinfo;
+    read_template(spath + rinfo.sname, rparams, ptemplate->img, ptemplate->mask);
+    BGHMatcher::init_ghough_table_from_img(
+        ptemplate->img, ptemplate->mask, ptemplate->table, rparams, ptemplate->img_grad);
+    if (is_pose)
+    {
+        BGHMatcher::create_ghough_pose_grid(ptemplate->table, BGHMatcher::T_ghough_pose_search(), ptemplate->grid);
+    }
+    ptemplate->build_ms = 1000.0 * static_cast<double>(cv::getTickCount() - t0) / cv::getTickFrequency();
+    return ptemplate;
+}
+
+
+std::shared_ptr<const T_template> TemplateLoader::load_view(
+    const T_file_info& rinfo,
+    const BGHMatcher::T_ghough_table& rview) const
+{
+    int64_t t0 = cv::getTickCount();
+    std::shared_ptr<T_template> ptemplate = std::make_shared<T_template>();
+    ptemplate->info = rinfo;
+    read_template(spath + rinfo.sname, rview.params, ptemplate->img, ptemplate->mask);
+
+    // encoded gradients are only for display so every edge pixel is kept
+    BGHMatcher::T_ghough_params params = rview.params;
+    params.max_vote_pix = 0;
+    BGHMatcher::create_masked_gradient_orientation_img(ptemplate->img, ptemplate->img_grad, params);
+    BGHMatcher::create_ghough_table_view(rview, ptemplate->table);
+    ptemplate->build_ms = 1000.0 * static_cast<double>(cv::getTickCount() - t0) / cv::getTickFrequency();
+    return ptemplate;
+}
+
+
+void TemplateLoader::request(
+    const T_file_info& rinfo,
+    const BGHMatcher::T_ghough_params& rparams,
+    const bool is_pose)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        req_info = rinfo;
+        req_params = rparams;
+        req_is_pose = is_pose;
+        is_requested = true;
+    }
+    req_cv.notify_all();
+}
+
+
+std::shared_ptr<const T_template> TemplateLoader::take_ready(void)
+{
+    return std::atomic_exchange(&pready, std::shared_ptr<const T_template>());
+}
+
+
+void TemplateLoader::worker(void)
+{
+    while (true)
+    {
+        T_file_info info;
+        BGHMatcher::T_ghough_params params;
+        bool is_pose = false;
+
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            req_cv.wait(lock, [this] { return is_stopping || is_requested; });
+            if (is_stopping)
+            {
+                break;
+            }
+            info = req_info;
+            params = req_params;
+            is_pose = req_is_pose;
+            is_requested = false;
+        }
+
+        // publish new template
+        // any template that was published but never taken is released here
+        std::atomic_store(&pready, load(info, params, is_pose));
+    }
+}
@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TEMPLATE_LOADER_H_
+#define TEMPLATE_LOADER_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "BGHMatcher.h"
+#include "util.h"
+
+// A template image bundled with the lookup table built from it
+// and the coarse grid of tables for a pose search.
+// If the template has a foreground mask then the image is cropped to it.
+// Pose grid is only built when a pose search is enabled.
+// A template made from a view of a shared table has no pose grid.
+// It is never modified after it is published so any number of frames can share it.
+typedef struct _T_template_struct
+{
+    T_file_info info;
+    cv::Mat img;
+    cv::Mat mask;
+    cv::Mat img_grad;
+    BGHMatcher::T_ghough_table table;
+    BGHMatcher::T_ghough_pose_grid grid;
+    double build_ms;
+} T_template;
+
+// Builds templates on a background thread so the image processing loop never stalls.
+// A finished template is published with an atomic shared pointer store and the loop
+// takes it at the start of its next frame.  A template is freed when the last frame
+// (or pending slot) that refers to it lets go of its pointer.
+// A request made while another one is still waiting replaces the waiting one.
+class TemplateLoader
+{
+public:
+
+    TemplateLoader(const std::string& rspath);
+    virtual ~TemplateLoader();
+
+    // Builds a template on the calling thread and returns it.
+    // Pose grid is only built if pose search is enabled.
+    std::shared_ptr<const T_template> load(
+        const T_file_info& rinfo,
+        const BGHMatcher::T_ghough_params& rparams,
+        const bool is_pose) const;
+
+    // Creates a template on the calling thread whose table is a view of an existing table.
+    // Nothing is built.  The template image is only read and encoded for display.
+    // Source table must outlive the template.
+    std::shared_ptr<const T_template> load_view(
+        const T_file_info& rinfo,
+        const BGHMatcher::T_ghough_table& rview) const;
+
+    // Queues a template to be built on the background thread.
+    void request(
+        const T_file_info& rinfo,
+        const BGHMatcher::T_ghough_params& rparams,
+        const bool is_pose);
+
+    // Takes the most recently published template.
+    // Returns empty pointer if nothing new has been published.
+    std::shared_ptr<const T_template> take_ready(void);
+
+private:
+
+    void worker(void);
+
+    // Path to template image files
+    std::string spath;
+
+    // Background thread and its signaling
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable req_cv;
+    bool is_stopping;
+    bool is_requested;
+
+    // Most recent request that has not been started yet
+    T_file_info req_info;
+    BGHMatcher::T_ghough_params req_params;
+    bool req_is_pose;
+
+    // Template that is ready to be taken (only accessed with atomic shared pointer ops)
+    std::shared_ptr<const T_template> pready;
+};
+
+#endif // TEMPLATE_LOADER_H_
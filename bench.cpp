@@ -0,0 +1,1070 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#include "BGHMatcher.h"
+#include "BGHScheduler.h"
+#include "bench.h"
+
+
+#define BENCH_ITERATIONS    (20)
+#define BENCH_SCENE_W       (640)
+#define BENCH_SCENE_H       (480)
+
+
+// Creates a synthetic grayscale scene with a template at a known location.
+// The scene is blurred the same way camera frames are blurred in the main loop.
+static void make_scene(
+    const cv::Mat& rtemplate,
+    const int kblur,
+    cv::Mat& rscene,
+    cv::Point& rptcenter)
+{
+    rscene = cv::Mat(BENCH_SCENE_H, BENCH_SCENE_W, CV_8U, cv::Scalar(255));
+    cv::Size tsz = rtemplate.size();
+    cv::Point corner = { (BENCH_SCENE_W - tsz.width) / 3, (BENCH_SCENE_H - tsz.height) / 3 };
+    rtemplate.copyTo(rscene(cv::Rect(corner, tsz)));
+    rptcenter = { corner.x + tsz.width / 2, corner.y + tsz.height / 2 };
+    if (kblur > 1)
+    {
+        cv::GaussianBlur(rscene, rscene, { kblur, kblur }, 0);
+    }
+}
+
+
+// Returns elapsed time in milliseconds since a tick count.
+static double elapsed_ms(const int64_t t0)
+{
+    return 1000.0 * static_cast<double>(cv::getTickCount() - t0) / cv::getTickFrequency();
+}
+
+
+void run_benchmarks(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    bench_nms(rspath, rvfiles);
+    bench_sampling(rspath, rvfiles);
+    bench_layout(rspath, rvfiles);
+    bench_binned(rspath, rvfiles);
+    bench_cascade(rspath, rvfiles);
+    bench_scaled(rspath, rvfiles);
+    bench_scheduler(rspath, rvfiles);
+    bench_reduce(rspath, rvfiles);
+    bench_union(rspath, rvfiles);
+    bench_library(rspath, rvfiles);
+    bench_coded(rspath, rvfiles);
+    bench_lowrank(rspath, rvfiles);
+}
+
+
+void bench_nms(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    std::cout << std::endl;
+    std::cout << "NMS BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        NMS  ENTRIES  VOTE_PIX   MS/FRAME  SCORE  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+
+        // compare no thinning to thinning with increasing tolerance
+        for (int nms_tol = -1; nms_tol <= 1; nms_tol++)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_grad;
+            cv::Mat img_match;
+            BGHMatcher::T_ghough_table table;
+
+            params.nms_tol = nms_tol;
+            BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+            BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+            table.params = params;
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, table.params);
+                BGHMatcher::apply_ghough_transform_allpix<CV_16U, uint16_t>(img_grad, img_match, table);
+            }
+            double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+            cv::Point pterr = ptmax - ptcenter;
+
+            std::ostringstream oss;
+            oss << ((nms_tol < 0) ? "off" : std::to_string(nms_tol));
+            std::cout << std::left << std::setw(32) << rinfo.sname;
+            std::cout << std::setw(4) << oss.str() << std::right;
+            std::cout << std::setw(8) << table.total_entries;
+            std::cout << std::setw(10) << cv::countNonZero(img_grad);
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(11) << ms;
+            std::cout << std::setw(7) << (qmax / table.total_votes);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_sampling(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    const std::vector<std::string> smode({ "all", "grid", "checker" });
+    const std::vector<BGHMatcher::T_ghough_sampling> vsamp =
+    {
+        { BGHMatcher::SAMPLE_ALL, 1 },
+        { BGHMatcher::SAMPLE_GRID, 2 },
+        { BGHMatcher::SAMPLE_CHECKER, 2 },
+        { BGHMatcher::SAMPLE_GRID, 3 },
+    };
+
+    std::cout << std::endl;
+    std::cout << "SAMPLING BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        MODE     S   MS/FRAME  SCORE  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        for (const auto& rsamp : vsamp)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_match;
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, table, rsamp);
+            }
+            double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+            cv::Point pterr = ptmax - ptcenter;
+
+            std::cout << std::left << std::setw(32) << rinfo.sname;
+            std::cout << std::setw(8) << smode[rsamp.mode] << std::right;
+            std::cout << std::setw(2) << rsamp.stride;
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(11) << ms;
+            std::cout << std::setw(7) << (qmax / table.total_votes);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_layout(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // tile shift 0 means the ordinary row-major accumulator
+    const std::vector<double> vscale({ 1.0, 2.0, 3.0 });
+    const std::vector<int> vshift({ 0, 3, 4 });
+
+    std::cout << std::endl;
+    std::cout << "LAYOUT BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        SCALE  ENTRIES  TILE   MS/FRAME  SCORE  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template0 = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template0.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        for (const auto& rscale : vscale)
+        {
+            // enlarge template to get bigger voting tables
+            // and skip it if it no longer fits in the scene
+            cv::Mat img_template;
+            cv::resize(img_template0, img_template, {}, rscale, rscale, cv::INTER_LINEAR);
+            if ((img_template.cols >= BENCH_SCENE_W) || (img_template.rows >= BENCH_SCENE_H))
+            {
+                continue;
+            }
+
+            cv::Mat img_scene;
+            cv::Mat img_grad;
+            cv::Point ptcenter;
+            BGHMatcher::T_ghough_table table;
+            BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+            make_scene(img_template, params.kblur, img_scene, ptcenter);
+            BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+            BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+            table.params = params;
+            BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+            for (const auto& rshift : vshift)
+            {
+                double qmax;
+                cv::Point ptmax;
+                cv::Mat img_match;
+                BGHMatcher::T_ghough_tiled_acc acc;
+                acc.tile_shift = rshift;
+
+                int64_t t0 = cv::getTickCount();
+                for (int n = 0; n < BENCH_ITERATIONS; n++)
+                {
+                    if (rshift == 0)
+                    {
+                        BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, table);
+                    }
+                    else
+                    {
+                        BGHMatcher::apply_ghough_transform_tiled<CV_32F, float>(img_grad, acc, table);
+                    }
+                }
+                double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+                if (rshift != 0)
+                {
+                    BGHMatcher::convert_tiled_acc(acc, img_match);
+                }
+                cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+                cv::Point pterr = ptmax - ptcenter;
+
+                std::ostringstream oss;
+                oss << ((rshift == 0) ? std::string("row") : std::to_string(1 << rshift));
+                std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+                std::cout << std::fixed << std::setprecision(1);
+                std::cout << std::setw(5) << rscale;
+                std::cout << std::setw(9) << table.total_entries;
+                std::cout << std::setw(6) << oss.str();
+                std::cout << std::fixed << std::setprecision(2);
+                std::cout << std::setw(11) << ms;
+                std::cout << std::setw(7) << (qmax / table.total_votes);
+                std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+                std::cout << std::endl;
+            }
+        }
+    }
+}
+
+
+void bench_binned(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // bin 1 is ordinary full-resolution voting
+    const std::vector<int> vbin({ 1, 2, 4 });
+
+    std::cout << std::endl;
+    std::cout << "BINNED BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        BIN  ENTRIES  MS/FRAME  SCORE  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        for (const auto& rbin : vbin)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_match;
+            BGHMatcher::T_ghough_table table_bin;
+            BGHMatcher::create_binned_ghough_table(table, rbin, table_bin);
+
+            // binned search includes refinement of its best bin at full resolution
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                if (rbin > 1)
+                {
+                    cv::Point ptbin;
+                    BGHMatcher::apply_ghough_transform_binned<CV_32F, float>(img_grad, img_match, table_bin);
+                    cv::minMaxLoc(img_match, nullptr, nullptr, nullptr, &ptbin);
+                    BGHMatcher::refine_binned_match<CV_32F, float>(img_grad, table, ptbin, rbin, qmax, ptmax);
+                }
+                else
+                {
+                    BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, table);
+                    cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+                }
+            }
+            double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            cv::Point pterr = ptmax - ptcenter;
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::setw(3) << rbin;
+            std::cout << std::setw(9) << table_bin.total_entries;
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(10) << ms;
+            std::cout << std::setw(7) << (qmax / table.total_votes);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_cascade(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // threshold 0 is ordinary full voting
+    const std::vector<double> vthr({ 0.0, 0.3, 0.5, 0.7 });
+
+    std::cout << std::endl;
+    std::cout << "CASCADE BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        THR  MS/FRAME  SCORE  ERR  SAME" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        double qmax_full = 0.0;
+        cv::Point ptmax_full;
+        for (const auto& rthr : vthr)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_match;
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                if (rthr > 0.0)
+                {
+                    BGHMatcher::apply_ghough_transform_cascade<CV_32F, float>(img_grad, img_match, table, rthr);
+                }
+                else
+                {
+                    BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, table);
+                }
+            }
+            double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+            if (rthr == 0.0)
+            {
+                qmax_full = qmax;
+                ptmax_full = ptmax;
+            }
+            const bool is_same = (qmax == qmax_full) && (ptmax == ptmax_full);
+
+            cv::Point pterr = ptmax - ptcenter;
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::fixed << std::setprecision(1);
+            std::cout << std::setw(3) << rthr;
+            std::cout << std::setprecision(2);
+            std::cout << std::setw(10) << ms;
+            std::cout << std::setw(7) << (qmax / table.total_votes);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::setw(6) << (is_same ? "yes" : "NO");
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_scaled(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    const std::vector<double> vscale({ 0.75, 1.0, 1.5 });
+
+    std::cout << std::endl;
+    std::cout << "SCALED OFFSETS BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        SCALE  STORED_MS  SCALED_MS  SAME  SCORE  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_grad;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+
+        for (const auto& rscale : vscale)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_scene;
+            cv::Mat img_scaled;
+            cv::Mat img_match0;
+            cv::Mat img_match1;
+            cv::Point ptcenter;
+            cv::resize(img_template, img_scaled, cv::Size(), rscale, rscale);
+            make_scene(img_scaled, params.kblur, img_scene, ptcenter);
+
+            // stored table is built from the template gradients with the scale
+            BGHMatcher::T_ghough_table table_scale;
+            BGHMatcher::create_ghough_table(img_grad, rscale, table_scale);
+            table_scale.params = params;
+            table_scale.params.scale = rscale;
+
+            cv::Mat img_scene_grad;
+            BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_scene_grad, params);
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_scene_grad, img_match0, table_scale);
+            }
+            double ms0 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_scaled<CV_32F, float>(img_scene_grad, img_match1, table, rscale);
+            }
+            double ms1 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            // offsets can differ by a pixel in rare cases so match images may not be identical
+            const bool is_same = (cv::countNonZero(img_match0 != img_match1) == 0);
+            cv::minMaxLoc(img_match1, nullptr, &qmax, nullptr, &ptmax);
+            cv::Point pterr = ptmax - ptcenter;
+
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(5) << rscale;
+            std::cout << std::setw(11) << ms0;
+            std::cout << std::setw(11) << ms1;
+            std::cout << std::setw(6) << (is_same ? "yes" : "NO");
+            std::cout << std::setw(7) << (qmax / table.total_votes);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_scheduler(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // rotations give a set of jobs with different table sizes
+    const int rot_ct = 12;
+    BGHMatcher::GHoughScheduler scheduler;
+
+    std::cout << std::endl;
+    std::cout << "SCHEDULER BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << rot_ct << " rotations, " << scheduler.get_worker_ct() << " workers, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        SERIAL_MS  SCHED_MS  SPEEDUP  SAME  SCANNED" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        // tables can't be copied so build them in place
+        std::vector<BGHMatcher::T_ghough_table> vtables(rot_ct);
+        std::vector<const BGHMatcher::T_ghough_table *> vptables;
+        for (int k = 0; k < rot_ct; k++)
+        {
+            BGHMatcher::create_rotated_ghough_table(table, (CV_2PI * k) / rot_ct, vtables[k]);
+            vptables.push_back(&vtables[k]);
+        }
+
+        std::vector<BGHMatcher::T_ghough_peak> vserial(rot_ct);
+        int64_t t0 = cv::getTickCount();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+        {
+            for (int k = 0; k < rot_ct; k++)
+            {
+                cv::Mat img_match;
+                BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, vtables[k]);
+                cv::minMaxLoc(img_match, nullptr, &vserial[k].qmax, nullptr, &vserial[k].ptmax);
+            }
+        }
+        double ms_serial = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+        std::vector<BGHMatcher::T_ghough_peak> vsched;
+        t0 = cv::getTickCount();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+        {
+            scheduler.run(img_grad, vptables, vsched);
+        }
+        double ms_sched = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+        bool is_same = true;
+        for (int k = 0; k < rot_ct; k++)
+        {
+            is_same = is_same && (vserial[k].qmax == vsched[k].qmax) && (vserial[k].ptmax == vsched[k].ptmax);
+        }
+
+        std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(9) << ms_serial;
+        std::cout << std::setw(10) << ms_sched;
+        std::cout << std::setw(9) << (ms_serial / ms_sched);
+        std::cout << std::setw(6) << (is_same ? "yes" : "NO");
+
+        // ratio of input pixels visited by all bands to the pixels
+        // visited when each table scans the whole image once
+        const double serial_scanned = static_cast<double>(img_grad.rows - 2) * (img_grad.cols - 2) * rot_ct;
+        std::cout << std::setw(9) << (scheduler.get_scanned_ct() / serial_scanned);
+        std::cout << std::endl;
+    }
+}
+
+
+void bench_reduce(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    const int rot_ct = 12;
+    const int band_rows = 32;
+
+    std::cout << std::endl;
+    std::cout << "REDUCTION BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << rot_ct << " rotations, " << band_rows << " band rows, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        FULL_MS  BAND_MS  SAME  SCORE   ID" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        // tables can't be copied so build them in place
+        std::vector<BGHMatcher::T_ghough_table> vtables(rot_ct);
+        std::vector<const BGHMatcher::T_ghough_table *> vptables;
+        for (int k = 0; k < rot_ct; k++)
+        {
+            BGHMatcher::create_rotated_ghough_table(table, (CV_2PI * k) / rot_ct, vtables[k]);
+            vptables.push_back(&vtables[k]);
+        }
+
+        // full image match for every table is folded in as a single region
+        BGHMatcher::T_ghough_reduction red_full;
+        const cv::Rect roi_full = { 0, 0, img_grad.cols, img_grad.rows };
+        int64_t t0 = cv::getTickCount();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+        {
+            BGHMatcher::init_ghough_reduction(img_grad.size(), red_full);
+            for (int k = 0; k < rot_ct; k++)
+            {
+                cv::Mat img_match;
+                BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, vtables[k]);
+                BGHMatcher::fold_ghough_reduction(
+                    img_match, roi_full, vtables[k].total_votes, static_cast<uint16_t>(k), red_full);
+            }
+        }
+        double ms_full = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+        BGHMatcher::T_ghough_reduction red_band;
+        t0 = cv::getTickCount();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+        {
+            BGHMatcher::reduce_ghough_hypotheses(img_grad, vptables, band_rows, red_band);
+        }
+        double ms_band = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+        uint16_t id_full = 0;
+        uint16_t id_band = 0;
+        BGHMatcher::T_ghough_peak peak_full;
+        BGHMatcher::T_ghough_peak peak_band;
+        BGHMatcher::find_ghough_reduction_peak(red_full, peak_full, id_full);
+        BGHMatcher::find_ghough_reduction_peak(red_band, peak_band, id_band);
+        const bool is_same =
+            (peak_full.score == peak_band.score) && (peak_full.ptmax == peak_band.ptmax) && (id_full == id_band);
+
+        std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(7) << ms_full;
+        std::cout << std::setw(9) << ms_band;
+        std::cout << std::setw(6) << (is_same ? "yes" : "NO");
+        std::cout << std::setw(7) << peak_band.score;
+        std::cout << std::setw(5) << id_band;
+        std::cout << std::endl;
+    }
+}
+
+
+// Finds largest rotation (degrees) of the template in a scene where a table still
+// finds the template within a few pixels.  Rotations are tried in order until one fails.
+static double get_rotation_tolerance(
+    const cv::Mat& rtemplate,
+    const BGHMatcher::T_ghough_table& rtable,
+    const double deg_step,
+    const double deg_max)
+{
+    double deg_ok = 0.0;
+    for (double deg = 0.0; deg <= deg_max; deg += deg_step)
+    {
+        // rotate template with a white border to match the white scene
+        cv::Mat img_rot;
+        cv::Point2f ptc = { 0.5f * rtemplate.cols, 0.5f * rtemplate.rows };
+        cv::Mat rmat = cv::getRotationMatrix2D(ptc, deg, 1.0);
+        cv::warpAffine(rtemplate, img_rot, rmat, rtemplate.size(),
+            cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(255));
+
+        double qmax;
+        cv::Point ptmax;
+        cv::Point ptcenter;
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Mat img_match;
+        make_scene(img_rot, rtable.params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, rtable.params);
+        BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, rtable);
+        cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+        cv::Point pterr = ptmax - ptcenter;
+        if (std::max(std::abs(pterr.x), std::abs(pterr.y)) > 2)
+        {
+            break;
+        }
+        deg_ok = deg;
+    }
+    return deg_ok;
+}
+
+
+void bench_union(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // each union covers +/- a spread of angles with 5 poses
+    // spread 0 is the ordinary single pose table
+    const std::vector<double> vspread({ 0.0, 5.0, 10.0, 15.0 });
+    const int pose_ct = 5;
+    const int cap = 2;
+
+    std::cout << std::endl;
+    std::cout << "UNION TABLE BENCHMARK (" << pose_ct << " poses per union, cap " << cap << ")" << std::endl;
+    std::cout << "TEMPLATE                        SPREAD  ENTRIES  GROWTH  TOL_DEG" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_grad;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+
+        for (const auto& rspread : vspread)
+        {
+            std::vector<BGHMatcher::T_ghough_pose> vposes(pose_ct);
+            for (int k = 0; k < pose_ct; k++)
+            {
+                const double f = (2.0 * k) / (pose_ct - 1) - 1.0;
+                vposes[k].angle = f * rspread * CV_PI / 180.0;
+            }
+
+            BGHMatcher::T_ghough_table table_union;
+            BGHMatcher::create_union_ghough_table(table, vposes, (rspread > 0.0) ? cap : 0, table_union);
+            double tol = get_rotation_tolerance(img_template, table_union, 2.5, 45.0);
+
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::fixed << std::setprecision(1);
+            std::cout << std::setw(6) << rspread;
+            std::cout << std::setw(9) << table_union.total_entries;
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(8) << (static_cast<double>(table_union.total_entries) / table.total_entries);
+            std::cout << std::fixed << std::setprecision(1);
+            std::cout << std::setw(9) << tol;
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_library(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    const std::vector<size_t> vlibsize({ 1, 10, 100, 1000 });
+    const double prune_thr = 0.5;
+
+    // library is made from scaled and rotated copies of every data file
+    // so it has realistic tables with a big range of sizes
+    std::vector<BGHMatcher::T_ghough_table> vbase(rvfiles.size());
+    std::vector<cv::Mat> vimg(rvfiles.size());
+    for (size_t n = 0; n < rvfiles.size(); n++)
+    {
+        cv::Mat img_grad;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rvfiles[n].mag_thr, 8.0 };
+        vimg[n] = cv::imread(rspath + rvfiles[n].sname, cv::IMREAD_GRAYSCALE);
+        if (vimg[n].empty())
+        {
+            std::cout << rvfiles[n].sname << " not found" << std::endl;
+            return;
+        }
+        BGHMatcher::create_masked_gradient_orientation_img(vimg[n], img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, vbase[n]);
+        vbase[n].params = params;
+    }
+
+    // scene has the first template at normal size and rotation
+    // and template 0 in library is that template
+    cv::Mat img_scene;
+    cv::Mat img_grad;
+    cv::Point ptcenter;
+    make_scene(vimg[0], vbase[0].params.kblur, img_scene, ptcenter);
+    BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, vbase[0].params);
+
+    const size_t lib_max = vlibsize.back();
+    std::vector<BGHMatcher::T_ghough_table> vtables(lib_max);
+    std::vector<const BGHMatcher::T_ghough_table *> vptables;
+    for (size_t k = 0; k < lib_max; k++)
+    {
+        const size_t n = k % vbase.size();
+        const size_t m = k / vbase.size();
+        const double scale = 1.0 + 0.05 * static_cast<double>(static_cast<int>((m + 4) % 9) - 4);
+        const double angle = (CV_2PI * static_cast<double>(m / 9)) / 23.0;
+        BGHMatcher::create_posed_ghough_table(vbase[n], scale, angle, vtables[k]);
+        vptables.push_back(&vtables[k]);
+    }
+
+    std::cout << std::endl;
+    std::cout << "LIBRARY BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << "prune threshold " << prune_thr << ")" << std::endl;
+    std::cout << "TEMPLATES  TABLES_MS  INDEX_MS  SURVIVORS  BEST  SCORE  ERR" << std::endl;
+
+    for (const auto& rlibsize : vlibsize)
+    {
+        std::vector<const BGHMatcher::T_ghough_table *> vlib(vptables.begin(), vptables.begin() + rlibsize);
+
+        // one full vote per template
+        int64_t t0 = cv::getTickCount();
+        for (const auto& rptable : vlib)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_match;
+            BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, *rptable);
+            cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+        }
+        double ms_tables = elapsed_ms(t0);
+
+        // index is built once for the library so it is not timed
+        BGHMatcher::T_ghough_library lib;
+        std::vector<size_t> vids;
+        std::vector<BGHMatcher::T_ghough_peak> vpeaks;
+        BGHMatcher::create_ghough_library(vlib, lib);
+        t0 = cv::getTickCount();
+        BGHMatcher::prune_ghough_library(img_grad, lib, prune_thr, vids);
+        BGHMatcher::apply_ghough_library(img_grad, lib, vids, vpeaks);
+        double ms_index = elapsed_ms(t0);
+
+        // best surviving template
+        size_t nbest = 0;
+        for (size_t n = 1; n < vpeaks.size(); n++)
+        {
+            nbest = (vpeaks[n].score > vpeaks[nbest].score) ? n : nbest;
+        }
+        const bool is_found = !vpeaks.empty();
+        const cv::Point pterr = (is_found) ? (vpeaks[nbest].ptmax - ptcenter) : cv::Point(0, 0);
+
+        std::cout << std::setw(9) << rlibsize;
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(11) << ms_tables;
+        std::cout << std::setw(10) << ms_index;
+        std::cout << std::setw(11) << vids.size();
+        std::cout << std::setw(6) << ((is_found) ? std::to_string(vids[nbest]) : std::string("-"));
+        std::cout << std::setw(7) << ((is_found) ? vpeaks[nbest].score : 0.0);
+        std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+        std::cout << std::endl;
+    }
+}
+
+
+void bench_coded(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // step 12 has no specialized kernel so both columns should be about the same
+    const std::vector<double> vstep({ 8.0, 12.0, 16.0, 32.0, 64.0 });
+
+    std::cout << std::endl;
+    std::cout << "CODED KERNEL BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        STEP  CODED  GENERIC_MS  CODED_MS  SAME  GEN16_MS  COD16_MS  SAME16" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        for (const auto& rstep : vstep)
+        {
+            cv::Mat img_scene;
+            cv::Mat img_grad;
+            cv::Mat img_match0;
+            cv::Mat img_match1;
+            cv::Point ptcenter;
+            BGHMatcher::T_ghough_table table;
+            BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, rstep };
+            make_scene(img_template, params.kblur, img_scene, ptcenter);
+            BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+            BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+            table.params = params;
+            BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match0, table);
+            }
+            double ms0 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_dispatch<CV_32F, float>(img_grad, img_match1, table);
+            }
+            double ms1 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            const bool is_same = (cv::countNonZero(img_match0 != img_match1) == 0);
+
+            // 16-bit accumulators must saturate the same way in both kernels
+            t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_allpix<CV_16U, uint16_t>(img_grad, img_match0, table);
+            }
+            double ms2 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                BGHMatcher::apply_ghough_transform_dispatch<CV_16U, uint16_t>(img_grad, img_match1, table);
+            }
+            double ms3 = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            const bool is_same16 = (cv::countNonZero(img_match0 != img_match1) == 0);
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::fixed << std::setprecision(0);
+            std::cout << std::setw(4) << rstep;
+            std::cout << std::setw(7) << (BGHMatcher::is_ghough_params_coded(params) ? "yes" : "no");
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(12) << ms0;
+            std::cout << std::setw(10) << ms1;
+            std::cout << std::setw(6) << (is_same ? "yes" : "NO");
+            std::cout << std::setw(10) << ms2;
+            std::cout << std::setw(10) << ms3;
+            std::cout << std::setw(8) << (is_same16 ? "yes" : "NO");
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+void bench_lowrank(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles)
+{
+    // target 0 means the ordinary full table (its TERMS column is the entry count)
+    const std::vector<double> vtarget({ 0.0, 0.02, 0.05, 0.1, 0.2 });
+    const int max_rank = 16;
+
+    std::cout << std::endl;
+    std::cout << "LOW-RANK BENCHMARK (" << BENCH_SCENE_W << "x" << BENCH_SCENE_H << " scene, ";
+    std::cout << BENCH_ITERATIONS << " iterations)" << std::endl;
+    std::cout << "TEMPLATE                        TARGET  TERMS  MS/FRAME  SCORE  SCORE_ERR  ERR" << std::endl;
+
+    for (const auto& rinfo : rvfiles)
+    {
+        cv::Mat img_template = cv::imread(rspath + rinfo.sname, cv::IMREAD_GRAYSCALE);
+        if (img_template.empty())
+        {
+            std::cout << rinfo.sname << " not found" << std::endl;
+            continue;
+        }
+
+        cv::Mat img_scene;
+        cv::Mat img_grad;
+        cv::Point ptcenter;
+        BGHMatcher::T_ghough_table table;
+        BGHMatcher::T_ghough_params params = { 7, 7, 1.0, rinfo.mag_thr, 8.0 };
+        make_scene(img_template, params.kblur, img_scene, ptcenter);
+        BGHMatcher::create_masked_gradient_orientation_img(img_template, img_grad, params);
+        BGHMatcher::create_ghough_table(img_grad, params.scale, table);
+        table.params = params;
+        BGHMatcher::create_masked_gradient_orientation_img(img_scene, img_grad, params);
+
+        double score_full = 0.0;
+        for (const auto& rtarget : vtarget)
+        {
+            double qmax;
+            cv::Point ptmax;
+            cv::Mat img_match;
+            BGHMatcher::T_ghough_lowrank lowrank;
+            if (rtarget > 0.0)
+            {
+                BGHMatcher::create_ghough_lowrank(table, rtarget, max_rank, lowrank);
+            }
+
+            int64_t t0 = cv::getTickCount();
+            for (int n = 0; n < BENCH_ITERATIONS; n++)
+            {
+                if (rtarget > 0.0)
+                {
+                    BGHMatcher::apply_ghough_transform_lowrank(img_grad, img_match, lowrank);
+                }
+                else
+                {
+                    BGHMatcher::apply_ghough_transform_allpix<CV_32F, float>(img_grad, img_match, table);
+                }
+            }
+            double ms = elapsed_ms(t0) / BENCH_ITERATIONS;
+
+            cv::minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+            cv::Point pterr = ptmax - ptcenter;
+            const double score = qmax / table.total_votes;
+            score_full = (rtarget > 0.0) ? score_full : score;
+
+            std::cout << std::left << std::setw(32) << rinfo.sname << std::right;
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(6) << rtarget;
+            std::cout << std::setw(7) << ((rtarget > 0.0) ? lowrank.total_terms : table.total_entries);
+            std::cout << std::setw(10) << ms;
+            std::cout << std::setw(7) << score;
+            std::cout << std::setprecision(4);
+            std::cout << std::setw(11) << ((score_full > 0.0) ? (std::abs(score - score_full) / score_full) : 0.0);
+            std::cout << std::setw(5) << std::max(std::abs(pterr.x), std::abs(pterr.y));
+            std::cout << std::endl;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+// MIT License
+//
+// Copyright(c) 2018 Mark Whitney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// Runs all benchmarks on the templates in the data folder.
+// Each template is placed in a synthetic scene at a known location
+// so both speed and detection accuracy can be reported.
+void run_benchmarks(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares table size, voting pixels, and voting time with and without
+// non-maximum suppression (edge thinning) for each template.
+void bench_nms(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting time and scores for full voting and subsampled voting.
+void bench_sampling(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting time into a row-major accumulator and into tiled accumulators
+// for each template at normal size and at larger scales.
+void bench_layout(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares full-resolution voting against voting with a binned table
+// followed by full-resolution refinement of the best bin, for several bin factors.
+void bench_binned(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares full voting against cascade voting at several rejection thresholds.
+// Reports whether the cascade keeps the same peak as full voting.
+void bench_cascade(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting with a table stored for each scale against run-time scaling
+// of one base table, in scenes with a scaled copy of each template.
+void bench_scaled(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares one-table-at-a-time voting with the work-stealing scheduler
+// on a set of rotated tables for each template.
+// Also reports the pixels scanned by all bands relative to one full scan per table.
+void bench_scheduler(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting each rotated table over the whole image and folding it into a reduction
+// against banded voting and folding with reduce_ghough_hypotheses.
+// Reports whether both find the same peak and hypothesis.
+void bench_reduce(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Reports rotation tolerance of union tables that cover a range of poses
+// against the growth of the table compared to a single pose table.
+void bench_union(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares one table per template against the inverted library index with pruning
+// for libraries from 1 to 1000 templates (scaled and rotated copies of the data files).
+void bench_library(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting time of the generic kernel and the dispatched kernel
+// for several angle steps with float and 16-bit accumulators.
+// Steps of 8, 16, 32, and 64 use specialized kernels.
+void bench_coded(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+// Compares voting time and peak score of low-rank separable tables at several target
+// score errors against ordinary voting with the full table.
+void bench_lowrank(
+    const std::string& rspath,
+    const std::vector<T_file_info>& rvfiles);
+
+#endif // BENCH_H_
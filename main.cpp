@@ -33,11 +33,20 @@
 #include "BGHMatcher.h"
 #include "Knobs.h"
 #include "util.h"
+#include "bench.h"
+#include "TemplateLoader.h"
+#include "BGHTableStore.h"
+#include "BGHSimd.h"
 
 
 #define MATCH_DISPLAY_THRESHOLD (0.8)           // arbitrary
 #define MOVIE_PATH              ".\\movie\\"    // user may need to create or change this
 #define DATA_PATH               ".\\data\\"     // user may need to change this
+#ifdef _WIN32
+#define STORE_NAME              "Local\\BGHMatcherTables"
+#else
+#define STORE_NAME              "/BGHMatcherTables"
+#endif
 
 
 using namespace cv;
@@ -52,7 +61,6 @@ using namespace cv;
 #define SCA_WHITE   (cv::Scalar(255,255,255))
 
 
-Mat template_image;
 const char * stitle = "BGHMatcher";
 const double default_mag_thr = 0.2;
 int n_record_ctr = 0;
@@ -95,30 +103,37 @@ bool wait_and_check_keys(Knobs& rknobs)
 
 void image_output(
     Mat& rimg,
-    const double qmax,
+    const double score,
     const Point& rptmax,
     const Knobs& rknobs,
-    BGHMatcher::T_ghough_table& rtable)
+    const T_template& rtemplate,
+    const BGHMatcher::T_ghough_pose& rpose)
 {
+    const BGHMatcher::T_ghough_table& rtable = rtemplate.table;
     const int h_score = 16;
-    const double scale = rtable.params.scale;
+    const double scale = rtable.params.scale * rpose.scale;
 
     // determine size of "target" box
-    // it will vary depending on the scale parameter
+    // it will vary depending on the scale parameter and the scale of the pose
     Size rsz = rtable.img_sz;
     rsz.height *= scale;
     rsz.width *= scale;
     Point corner = { rptmax.x - rsz.width / 2, rptmax.y - rsz.height / 2 };
 
     // format score string for viewer (#.##)
+    // with scale and angle (degrees) if pose is being searched
     std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2) << (qmax / rtable.total_votes);
+    oss << std::fixed << std::setprecision(2) << score;
+    if (rknobs.get_pose_enabled())
+    {
+        oss << " s=" << rpose.scale << " a=" << std::setprecision(0) << (rpose.angle * 180.0 / CV_PI);
+    }
 
     // draw current template in upper right corner
     Mat bgr_template_img;
-    cvtColor(template_image, bgr_template_img, COLOR_GRAY2BGR);
+    cvtColor(rtemplate.img, bgr_template_img, COLOR_GRAY2BGR);
     Size osz = rimg.size();
-    Size tsz = template_image.size();
+    Size tsz = rtemplate.img.size();
     Rect roi = cv::Rect(osz.width - tsz.width, 0, tsz.width, tsz.height);
     bgr_template_img.copyTo(rimg(roi));
 
@@ -127,11 +142,24 @@ void image_output(
     rectangle(rimg, { osz.width - tsz.width, 0 }, { osz.width, tsz.height }, box_color, 2);
 
     // draw black background box then draw text score on top of it
-    rectangle(rimg, { corner.x,corner.y - h_score, 40, h_score }, SCA_BLACK, -1);
+    rectangle(rimg, { corner.x,corner.y - h_score, 10 * static_cast<int>(oss.str().size()), h_score }, SCA_BLACK, -1);
     putText(rimg, oss.str(), { corner.x,corner.y - 4 }, FONT_HERSHEY_PLAIN, 1.0, SCA_WHITE, 1);
 
     // draw rectangle around best match with yellow dot at center
-    rectangle(rimg, { corner.x, corner.y, rsz.width, rsz.height }, SCA_GREEN, 2);
+    // (rectangle is rotated if match has a rotated pose)
+    if (rpose.angle != 0.0)
+    {
+        Point2f pts[4];
+        RotatedRect(rptmax, Size2f(rsz.width, rsz.height), static_cast<float>(rpose.angle * 180.0 / CV_PI)).points(pts);
+        for (int k = 0; k < 4; k++)
+        {
+            line(rimg, pts[k], pts[(k + 1) % 4], SCA_GREEN, 2);
+        }
+    }
+    else
+    {
+        rectangle(rimg, { corner.x, corner.y, rsz.width, rsz.height }, SCA_GREEN, 2);
+    }
     circle(rimg, rptmax, 2, SCA_YELLOW, -1);
 
     // save each frame to a file if recording
@@ -147,30 +175,46 @@ void image_output(
 }
 
 
-void reload_template(
+BGHMatcher::T_ghough_params get_template_params(
     const Knobs& rknobs,
-    BGHMatcher::T_ghough_table& rtable,
     const T_file_info& rinfo)
 {
     int kblur = rknobs.get_pre_blur();
     int ksobel = rknobs.get_ksize();
-    std::string spath = DATA_PATH + rinfo.sname;
-    template_image = imread(spath, IMREAD_GRAYSCALE);
-    
-    BGHMatcher::init_ghough_table_from_img(
-        template_image, rtable, { kblur, ksobel, rinfo.img_scale, rinfo.mag_thr, 8.0 });
-    
-    std::cout << "Loaded template (blur,sobel) = " << kblur << "," << ksobel << "): ";
-    std::cout << rinfo.sname << " " << rtable.total_votes << std::endl;
+    BGHMatcher::T_ghough_params params = { kblur, ksobel, rinfo.img_scale, rinfo.mag_thr, 8.0 };
+    params.nms_tol = rknobs.get_nms_tol();
+    params.max_vote_pix = rknobs.get_max_vote_pix();
+    return params;
+}
+
+
+void show_template(const T_template& rtemplate)
+{
+    // GUI calls stay on this thread
+    // so the encoded template gradients are displayed here instead of by the loader
+    Mat img_display;
+    normalize(rtemplate.img_grad, img_display, 0, 255, cv::NORM_MINMAX);
+    imshow("GHTemplate", img_display);
+
+    const BGHMatcher::T_ghough_params& rparams = rtemplate.table.params;
+    std::cout << "Loaded template (blur,sobel,nms,maxpix) = " << rparams.kblur << "," << rparams.ksobel << ",";
+    std::cout << rparams.nms_tol << "," << rparams.max_vote_pix << "): ";
+    std::cout << rtemplate.info.sname << " " << rtemplate.table.total_votes;
+    std::cout << " symmetry=" << rtemplate.table.sym.order;
+    std::cout << " (" << std::fixed << std::setprecision(1) << rtemplate.build_ms << " ms)" << std::endl;
 }
 
 
-void loop(void)
+// Runs camera loop.  If a table store is attached then its tables (one per data file,
+// in the same order) are used as views whenever a template is selected, so nothing is
+// built until a table setting is changed.
+void loop(const BGHMatcher::GHoughTableStore * pstore)
 {
     Knobs theKnobs;
     int op_id;
 
     double qmax;
+    double score;
     Size capture_size;
     Point ptmax;
     
@@ -181,7 +225,14 @@ void loop(void)
     Mat img_channels[3];
     Mat img_match;
 
-    BGHMatcher::T_ghough_table theGHData;
+    TemplateLoader theLoader(DATA_PATH);
+    std::shared_ptr<const T_template> pTemplate;
+    BGHMatcher::T_ghough_temporal theTemporal;
+    BGHMatcher::T_ghough_tracker theTracker;
+    BGHMatcher::T_ghough_sparse_acc theSparseAcc;
+    BGHMatcher::T_ghough_pose thePose;
+    std::vector<BGHMatcher::T_ghough_pose> vposes;
+    T_scene_gate theGate = { theKnobs.get_gate_thr(), theKnobs.get_gate_max_age(), 8, 0, Mat() };
     Ptr<CLAHE> pCLAHE = createCLAHE();
 
     // need a 0 as argument
@@ -203,7 +254,17 @@ void loop(void)
     theKnobs.handle_keypress('0');
 
     // initialize lookup table
-    reload_template(theKnobs, theGHData, vfiles[nfile]);
+    // first one is built (or attached) right here so there is always a template for voting
+    const size_t attached_ct = (pstore) ? pstore->get_tables().size() : 0;
+    if (nfile < attached_ct)
+    {
+        pTemplate = theLoader.load_view(vfiles[nfile], pstore->get_tables()[nfile]);
+    }
+    else
+    {
+        pTemplate = theLoader.load(vfiles[nfile], get_template_params(theKnobs, vfiles[nfile]), theKnobs.get_pose_enabled());
+    }
+    show_template(*pTemplate);
 
     // and the image processing loop is running...
     bool is_running = true;
@@ -217,6 +278,9 @@ void loop(void)
         // might halt or reset the image processing loop
         if (theKnobs.get_op_flag(op_id))
         {
+            // any operation forces next frame to be processed
+            theGate.prev.release();
+
             if (op_id == Knobs::OP_TEMPLATE || op_id == Knobs::OP_UPDATE)
             {
                 // changing the template will advance the file index
@@ -224,7 +288,20 @@ void loop(void)
                 {
                     nfile = (nfile + 1) % vfiles.size();
                 }
-                reload_template(theKnobs, theGHData, vfiles[nfile]);
+
+                if ((op_id == Knobs::OP_TEMPLATE) && (nfile < attached_ct))
+                {
+                    // attached table only needs a view so it is switched right away
+                    pTemplate = theLoader.load_view(vfiles[nfile], pstore->get_tables()[nfile]);
+                    show_template(*pTemplate);
+                    theTemporal.clear();
+                    theTracker.clear();
+                }
+                else
+                {
+                    // table is built in background while frames keep coming
+                    theLoader.request(vfiles[nfile], get_template_params(theKnobs, vfiles[nfile]), theKnobs.get_pose_enabled());
+                }
             }
             else if (op_id == Knobs::OP_RECORD)
             {
@@ -252,6 +329,19 @@ void loop(void)
             }
         }
 
+        // switch to new template at frame boundary if one has been published
+        // previous template is freed here because no frame is using it anymore
+        std::shared_ptr<const T_template> pReady = theLoader.take_ready();
+        if (pReady)
+        {
+            pTemplate = pReady;
+            show_template(*pTemplate);
+            theTemporal.clear();
+            theTracker.clear();
+            theGate.prev.release();
+        }
+        const BGHMatcher::T_ghough_table& theGHData = pTemplate->table;
+
         // grab image
         vcap >> img;
 
@@ -262,40 +352,109 @@ void loop(void)
             static_cast<int>(capture_size.height * img_scale));
         resize(img, img_viewer, viewer_size);
         
-        // apply the current channel setting
-        int nchan = theKnobs.get_channel();
-        if (nchan == Knobs::ALL_CHANNELS)
-        {
-            // combine all channels into grayscale
-            cvtColor(img_viewer, img_gray, COLOR_BGR2GRAY);
-        }
-        else
+        // skip all processing and reuse last result if scene has not changed
+        // (the match image might not exist yet if it wasn't needed for display)
+        theGate.thr = theKnobs.get_gate_thr();
+        theGate.max_age = theKnobs.get_gate_max_age();
+        bool is_reused = theKnobs.get_gate_enabled() && is_scene_unchanged(img, theGate);
+        if (img_match.empty() &&
+            (theKnobs.get_output_mode() == Knobs::OUT_RAW || theKnobs.get_output_mode() == Knobs::OUT_GRAD))
         {
-            // select only one BGR channel
-            split(img_viewer, img_channels);
-            img_gray = img_channels[nchan];
+            is_reused = false;
         }
-        
-        // apply the current histogram equalization setting
-        if (theKnobs.get_equ_hist_enabled())
+        if (!is_reused)
         {
-            double c = theKnobs.get_clip_limit();
-            pCLAHE->setClipLimit(c);
-            pCLAHE->apply(img_gray, img_gray);
-        }
+            // apply the current channel setting
+            int nchan = theKnobs.get_channel();
+            if (nchan == Knobs::ALL_CHANNELS)
+            {
+                // combine all channels into grayscale
+                cvtColor(img_viewer, img_gray, COLOR_BGR2GRAY);
+            }
+            else
+            {
+                // select only one BGR channel
+                split(img_viewer, img_channels);
+                img_gray = img_channels[nchan];
+            }
 
-        // apply the current blur setting
-        if (kblur > 1)
-        {
-            GaussianBlur(img_gray, img_gray, { kblur, kblur }, 0);
-        }
+            // apply the current histogram equalization setting
+            if (theKnobs.get_equ_hist_enabled())
+            {
+                double c = theKnobs.get_clip_limit();
+                pCLAHE->setClipLimit(c);
+                pCLAHE->apply(img_gray, img_gray);
+            }
+
+            // apply the current blur setting
+            if (kblur > 1)
+            {
+                GaussianBlur(img_gray, img_gray, { kblur, kblur }, 0);
+            }
+
+            // create image of encoded Sobel gradient orientations from blurred input image
+            // then apply Generalized Hough transform and locate maximum (best match)
+            BGHMatcher::create_masked_gradient_orientation_img(img_gray, img_grad, theGHData.params);
+
+            // interleaved voting spreads the votes for each pixel over multiple frames
+            // tracking only does a full search every few frames
+            // pose search also finds scale and rotation of the best match
+            thePose = BGHMatcher::T_ghough_pose();
+            if (theKnobs.get_interleave_enabled())
+            {
+                BGHMatcher::apply_ghough_transform_temporal(img_grad, img_match, theGHData, theTemporal);
+                BGHMatcher::find_ghough_max(img_match, qmax, ptmax);
+            }
+            else if (theKnobs.get_tracking_enabled())
+            {
+                BGHMatcher::track_ghough_match<CV_16U, uint16_t>(
+                    img_grad, img_match, theGHData, theTracker, qmax, ptmax);
+
+                // tracked frames only vote in a window so put it in a full image if it is displayed
+                const bool is_match_shown =
+                    (theKnobs.get_output_mode() == Knobs::OUT_RAW) ||
+                    (theKnobs.get_output_mode() == Knobs::OUT_GRAD);
+                if (!theTracker.is_full_search && is_match_shown)
+                {
+                    Mat temp_match = Mat::zeros(img_grad.size(), img_match.type());
+                    img_match.copyTo(temp_match(theTracker.roi));
+                    img_match = temp_match;
+                }
+            }
+            else if (theKnobs.get_pose_enabled() && !pTemplate->grid.tables.empty())
+            {
+                // attached templates (and ones built before pose was turned on) have no pose grid
+                // so they use one of the modes below
+                BGHMatcher::search_ghough_pose(img_grad, theGHData, pTemplate->grid, img_match, vposes);
+                thePose = vposes.front();
+                qmax = thePose.qmax;
+                ptmax = thePose.pt;
+            }
+            else if (theKnobs.get_output_mode() == Knobs::OUT_RAW ||
+                theKnobs.get_output_mode() == Knobs::OUT_GRAD)
+            {
+                BGHMatcher::apply_ghough_transform_dispatch<CV_16U, uint16_t>(img_grad, img_match, theGHData);
+                BGHMatcher::find_ghough_max(img_match, qmax, ptmax);
+            }
+            else
+            {
+                // match image is not displayed so sparse voting can be used if it's faster
+                BGHMatcher::find_ghough_match(img_grad, theGHData, theSparseAcc, qmax, ptmax);
+            }
 
-        // create image of encoded Sobel gradient orientations from blurred input image
-        // then apply Generalized Hough transform and locate maximum (best match)
-        BGHMatcher::create_masked_gradient_orientation_img(img_gray, img_grad, theGHData.params);
-        BGHMatcher::apply_ghough_transform_allpix<CV_16U, uint16_t>(img_grad, img_match, theGHData);
+            // posed tables have their own vote totals
+            score = (thePose.qmax > 0.0) ? thePose.score : (qmax / theGHData.total_votes);
 
-        minMaxLoc(img_match, nullptr, &qmax, nullptr, &ptmax);
+            // reset the history of any mode that was skipped
+            if (!theKnobs.get_interleave_enabled())
+            {
+                theTemporal.clear();
+            }
+            if (theKnobs.get_interleave_enabled() || !theKnobs.get_tracking_enabled())
+            {
+                theTracker.clear();
+            }
+        }
 
         // apply the current output mode
         // content varies but all final output images are BGR
@@ -305,8 +464,7 @@ void loop(void)
             {
                 // show the raw match result
                 Mat temp_8U;
-                normalize(img_match, img_match, 0, 255, cv::NORM_MINMAX);
-                img_match.convertTo(temp_8U, CV_8U);
+                BGHMatcher::create_ghough_display_img(img_match, temp_8U);
                 cvtColor(temp_8U, img_viewer, COLOR_GRAY2BGR);
                 break;
             }
@@ -338,7 +496,7 @@ void loop(void)
         }
 
         // always show best match contour and target dot on BGR image
-        image_output(img_viewer, qmax, ptmax, theKnobs, theGHData);
+        image_output(img_viewer, score, ptmax, theKnobs, *pTemplate, thePose);
 
         // handle keyboard events and end when ESC is pressed
         is_running = wait_and_check_keys(theKnobs);
@@ -350,8 +508,80 @@ void loop(void)
 }
 
 
+void publish_tables(void)
+{
+    // build a table for every template with default settings
+    // templates are loaded (masked and cropped) the same way as in the camera loop
+    // so attached tables match the tables the loop would build
+    Knobs theKnobs;
+    TemplateLoader theLoader(DATA_PATH);
+    std::vector<std::shared_ptr<const T_template>> vtemplates;
+    std::vector<const BGHMatcher::T_ghough_table *> vptables;
+    for (size_t k = 0; k < vfiles.size(); k++)
+    {
+        // published tables have no use for a pose grid
+        vtemplates.push_back(theLoader.load(vfiles[k], get_template_params(theKnobs, vfiles[k]), false));
+        vptables.push_back(&vtemplates.back()->table);
+    }
+
+    // segment exists as long as this process has it open
+    BGHMatcher::GHoughTableStore theStore;
+    if (theStore.publish(STORE_NAME, vptables))
+    {
+        std::cout << "Published " << vptables.size() << " tables to " << STORE_NAME << std::endl;
+        std::cout << "Press Enter to stop publishing..." << std::endl;
+        std::cin.get();
+    }
+    else
+    {
+        std::cout << "Failed to publish tables to " << STORE_NAME << std::endl;
+    }
+}
+
+
+void attach_tables(void)
+{
+    // store must outlive the loop because its templates are views into it
+    BGHMatcher::GHoughTableStore theStore;
+    if (theStore.attach(STORE_NAME))
+    {
+        const std::vector<BGHMatcher::T_ghough_table>& rvtables = theStore.get_tables();
+        for (size_t k = 0; k < rvtables.size(); k++)
+        {
+            std::cout << "Table " << k << ": entries=" << rvtables[k].total_entries;
+            std::cout << " votes=" << rvtables[k].total_votes;
+            std::cout << " symmetry=" << rvtables[k].sym.order << std::endl;
+        }
+        loop(&theStore);
+    }
+    else
+    {
+        std::cout << "Failed to attach to " << STORE_NAME << std::endl;
+    }
+}
+
+
 int main(int argc, char** argv)
 {
-    loop();
+    // pick vector kernels for this CPU once at startup (prints the selected path)
+    BGHMatcher::get_simd_kernels();
+
+    // run benchmarks instead of camera loop if requested
+    if ((argc > 1) && (std::string(argv[1]) == "-bench"))
+    {
+        run_benchmarks(DATA_PATH, vfiles);
+    }
+    else if ((argc > 1) && (std::string(argv[1]) == "-publish"))
+    {
+        publish_tables();
+    }
+    else if ((argc > 1) && (std::string(argv[1]) == "-attach"))
+    {
+        attach_tables();
+    }
+    else
+    {
+        loop(nullptr);
+    }
     return 0;
 }
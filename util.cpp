@@ -22,6 +22,7 @@
 
 #include "Windows.h"
 
+#include "opencv2/imgproc.hpp"
 #include "opencv2/highgui.hpp"
 
 #include <list>
@@ -90,3 +91,42 @@ bool make_video(
 
     return result;
 }
+
+
+bool is_scene_unchanged(
+    const cv::Mat& rimg,
+    T_scene_gate& rgate)
+{
+    bool result = false;
+
+    // shrink first so the color conversion is cheap
+    cv::Mat img_small;
+    int shrink = (rgate.shrink < 1) ? 1 : rgate.shrink;
+    cv::Size small_size = cv::Size(rimg.cols / shrink, rimg.rows / shrink);
+    cv::resize(rimg, img_small, small_size, 0, 0, cv::INTER_AREA);
+    if (img_small.channels() == 3)
+    {
+        cv::cvtColor(img_small, img_small, cv::COLOR_BGR2GRAY);
+    }
+
+    // always compare against the last processed frame
+    // so a slow drift will eventually exceed the threshold
+    if ((rgate.prev.size() == img_small.size()) && (rgate.age < rgate.max_age))
+    {
+        cv::Mat img_diff;
+        cv::absdiff(img_small, rgate.prev, img_diff);
+        result = (cv::mean(img_diff)[0] < rgate.thr);
+    }
+
+    if (result)
+    {
+        rgate.age++;
+    }
+    else
+    {
+        rgate.prev = img_small;
+        rgate.age = 0;
+    }
+
+    return result;
+}
@@ -26,6 +26,8 @@
 #include <string>
 #include <list>
 
+#include "opencv2/core.hpp"
+
 typedef struct
 {
     double mag_thr;
@@ -33,6 +35,17 @@ typedef struct
     std::string sname;
 } T_file_info;
 
+// State for detecting frames that are effectively unchanged.
+// Threshold is mean absolute difference (0-255) of downsampled grayscale frames.
+typedef struct
+{
+    double thr;
+    int max_age;
+    int shrink;
+    int age;
+    cv::Mat prev;
+} T_scene_gate;
+
 // Get list of all files in a directory that match a pattern
 void get_dir_list(
     const std::string& rsdir,
@@ -54,4 +67,11 @@ bool make_video(
     const int iFOURCC,
     const std::list<std::string>& rListOfPNG);
 
+// Compares a downsampled copy of a BGR frame with the last frame that was processed.
+// Returns true if the frame is effectively unchanged and the result for the last processed
+// frame can be reused.  A result can't be reused for more than the max age in frames.
+bool is_scene_unchanged(
+    const cv::Mat& rimg,
+    T_scene_gate& rgate);
+
 #endif // UTIL_H_